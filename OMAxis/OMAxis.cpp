@@ -31,6 +31,9 @@
 
 OMAxis::OMAxis(HardwareSerial& c_serObj) : OMMoCoMaster(c_serObj) {
     m_slaveAddr = 2;
+    
+    m_cacheNext = 0;
+    memset(m_cacheAddr, 0, sizeof(m_cacheAddr));
 }
 
 
@@ -90,7 +93,14 @@ uint8_t OMAxis::target() {
  */
 
 bool OMAxis::interval(unsigned long p_ms) {
-	return ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_CAM, SC_CAM_INTERVAL, p_ms) > 0 );
+	bool ok = ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_CAM, SC_CAM_INTERVAL, p_ms) > 0 );
+
+	OMAxisMirror* st = _cacheWrite(ok, 1UL << OM_STAT_INTERVAL);
+
+	if( st != 0 )
+		st->interval = p_ms;
+
+	return ok;
 }
 
 /** Set Exposure Time for Automatic Operation
@@ -103,7 +113,14 @@ bool OMAxis::interval(unsigned long p_ms) {
 
  */
 bool OMAxis::exposure(unsigned long p_ms) {
-	return ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_CAM, SC_CAM_EXPOSURE, p_ms) > 0 );
+	bool ok = ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_CAM, SC_CAM_EXPOSURE, p_ms) > 0 );
+
+	OMAxisMirror* st = _cacheWrite(ok, 1UL << OM_STAT_EXPTM);
+
+	if( st != 0 )
+		st->exposureTime = p_ms;
+
+	return ok;
 
 }
 
@@ -204,7 +221,14 @@ bool OMAxis::repeat(uint8_t p_count) {
  */
 
 bool OMAxis::steps(unsigned int p_steps) {
-	return ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_MOTOR, SC_MOT_STEPS, p_steps) > 0 );
+	bool ok = ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_MOTOR, SC_MOT_STEPS, p_steps) > 0 );
+
+	OMAxisMirror* st = _cacheWrite(ok, 1UL << OM_STAT_STEPS);
+
+	if( st != 0 )
+		st->steps = p_steps;
+
+	return ok;
 }
 
 
@@ -241,7 +265,14 @@ bool OMAxis::dir(bool p_dir) {
  
  */
 bool OMAxis::maxSteps(unsigned long p_steps) {
-	return ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_MOTOR, SC_MOT_MAXSTEP, p_steps) > 0 );
+	bool ok = ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_MOTOR, SC_MOT_MAXSTEP, p_steps) > 0 );
+
+	OMAxisMirror* st = _cacheWrite(ok, 1UL << OM_STAT_MAXSTEPS);
+
+	if( st != 0 )
+		st->maxSteps = p_steps;
+
+	return ok;
 }
 
 
@@ -258,7 +289,14 @@ bool OMAxis::maxSteps(unsigned long p_steps) {
  */
 bool OMAxis::enableMotor(bool p_en) {
     uint8_t comCode = p_en ? SC_MOT_ENABLE : SC_MOT_DISABLE;
-	return ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_MOTOR, comCode) > 0 );
+	bool ok = ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_MOTOR, comCode) > 0 );
+
+	OMAxisMirror* st = _cacheWrite(ok, 1UL << OM_STAT_MOTOREN);
+
+	if( st != 0 )
+		st->motorEnabled = p_en;
+
+	return ok;
 }
 
 
@@ -285,7 +323,14 @@ bool OMAxis::setHome(void) {
  
  */
 bool OMAxis::backlash(uint8_t p_steps) {
-	return ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_MOTOR, SC_MOT_BACKLASH, p_steps) > 0 );
+	bool ok = ( command(m_slaveAddr, OM_PCODE_PDS, OM_PCODE_MOTOR, SC_MOT_BACKLASH, p_steps) > 0 );
+
+	OMAxisMirror* st = _cacheWrite(ok, 1UL << OM_STAT_BACKLASH);
+
+	if( st != 0 )
+		st->backlash = p_steps;
+
+	return ok;
 }
 
 
@@ -407,7 +452,14 @@ bool OMAxis::stop() {
  */
 bool OMAxis::enableCamera(bool p_en) {
     uint8_t com = p_en ? CMD_PC_CAM_ENABLE : CMD_PC_CAM_DISABLE;
-	return ( command(m_slaveAddr, OM_PCODE_PC, com) > 0 );
+	bool ok = ( command(m_slaveAddr, OM_PCODE_PC, com) > 0 );
+
+	OMAxisMirror* st = _cacheWrite(ok, 1UL << OM_STAT_CAMEN);
+
+	if( st != 0 )
+		st->camEnabled = p_en;
+
+	return ok;
 }
 
 
@@ -550,7 +602,14 @@ bool OMAxis::ms(MicroSteps p_micros) {
  
  */
 bool OMAxis::master(bool p_en) {
-	return ( command(m_slaveAddr, OM_PCODE_PC, CMD_PC_TIMING_MASTER, (uint8_t) p_en) > 0 );
+	bool ok = ( command(m_slaveAddr, OM_PCODE_PC, CMD_PC_TIMING_MASTER, (uint8_t) p_en) > 0 );
+
+	OMAxisMirror* st = _cacheWrite(ok, 1UL << OM_STAT_MASTER);
+
+	if( st != 0 )
+		st->master = p_en;
+
+	return ok;
 }
 
 /** Specify Maximum Program Run Time
@@ -731,6 +790,250 @@ bool OMAxis::comLinePulse(ComLine p_com) {
     return ( command(m_slaveAddr, OM_PCODE_PC, CMD_PC_COMLINE, (uint8_t) p_com) > 0 );
 }
 
+/** Upload Key Frames in Bulk
+ 
+ Sends a run of key frames for one axis packed into as few packets as possible,
+ rather than sending each value as a separate command. Abscissas are sent as
+ whole milliseconds, positions as whole steps and derivatives as fixed-point
+ values with p_dq fraction bits (e.g. 12 gives a resolution of 1/4096 steps per ms
+ and a range of +/-8 steps per ms).
+ 
+ The arrays hold the whole program, and frames p_first to p_first + p_count - 1
+ are sent. Frames must be sent in order, following on from those the node has
+ already received for the axis.
+ 
+ Each packet carries up to five frames, or three when derivatives are sent.
+ 
+ Abscissas are sent as the change from the previous frame, so each must lie
+ within 65535 ms of the one before it (the first within 65535 ms of zero), and
+ positions must fit in 24 bits.  Nothing is sent if any frame is out of range.
+ 
+ @param p_axis
+ The key frame axis on the node
+ 
+ @param p_first
+ Index of the first key frame to send
+ 
+ @param p_count
+ Number of key frames to send
+ 
+ @param p_xn
+ Key frame abscissas, in milliseconds
+ 
+ @param p_fn
+ Key frame positions, in steps
+ 
+ @param p_dn
+ Key frame derivatives, in steps per millisecond, or NULL if the node generates them
+ 
+ @param p_dq
+ Number of fraction bits used to send the derivatives
+ 
+ @return
+ Whether or not every packet succeeded, false without sending anything if a
+ frame can't be encoded.
+ */
+
+bool OMAxis::keyFrames(uint8_t p_axis, unsigned int p_first, unsigned int p_count, float* p_xn, float* p_fn, float* p_dn, uint8_t p_dq) {
+    
+    uint8_t frameLen = p_dn != NULL ? OM_KFB_FRAME_DN : OM_KFB_FRAME;
+    uint8_t perPacket = (OM_SER_BUFLEN - 1 - OM_KFB_HEADER) / frameLen;
+    float dScale = (unsigned long) 1 << (p_dq & OM_KFB_QMASK);
+    uint8_t buf[OM_SER_BUFLEN];
+    
+        // deltas are sent in two bytes and positions in three, check them all
+        // before the first packet so a bad frame can't leave a partial upload
+    for( unsigned int i = p_first; i < p_first + p_count; i++ ) {
+        long dx = lround(p_xn[i]) - (i > 0 ? lround(p_xn[i - 1]) : 0);
+        long f = lround(p_fn[i]);
+        
+        if( dx < 0 || dx > 65535 || f < -8388608L || f > 8388607L )
+            return false;
+    }
+    
+    unsigned int frame = p_first;
+    
+    while( frame < p_first + p_count ) {
+        
+        uint8_t count = p_first + p_count - frame > perPacket ? perPacket : p_first + p_count - frame;
+        uint8_t len = 0;
+        
+        buf[len++] = CMD_PC_KF_BULK;
+        buf[len++] = p_axis;
+        buf[len++] = frame >> 8;
+        buf[len++] = frame & 0xFF;
+        buf[len++] = count;
+        buf[len++] = (p_dn != NULL ? OM_KFB_DN : 0) | (p_dq & OM_KFB_QMASK);
+        
+        for( uint8_t i = 0; i < count; i++, frame++ ) {
+                // deltas are taken between rounded abscissas, so rounding doesn't accumulate
+            unsigned int dx = lround(p_xn[frame]) - (frame > 0 ? lround(p_xn[frame - 1]) : 0);
+            long f = lround(p_fn[frame]);
+            
+            buf[len++] = dx >> 8;
+            buf[len++] = dx & 0xFF;
+            buf[len++] = (f >> 16) & 0xFF;
+            buf[len++] = (f >> 8) & 0xFF;
+            buf[len++] = f & 0xFF;
+            
+            if( p_dn != NULL ) {
+                long d = lround(p_dn[frame] * dScale);
+                d = d > 32767 ? 32767 : (d < -32768 ? -32768 : d);
+                buf[len++] = (d >> 8) & 0xFF;
+                buf[len++] = d & 0xFF;
+            }
+        }
+        
+        if( command(m_slaveAddr, OM_PCODE_PC, (char*) buf, len) <= 0 )
+            return false;
+    }
+    
+    return true;
+}
+
+/** Edit One Key Frame
+ 
+ Replaces a single key frame the node has already received, e.g. while the user
+ drags it, without sending the rest of the axis again.  The node only updates the
+ segments either side of the frame.  The abscissa must stay between those of the
+ neighbouring frames.
+ 
+ @param p_axis
+ The key frame axis on the node
+ 
+ @param p_which
+ Index of the key frame
+ 
+ @param p_x
+ Abscissa, in milliseconds
+ 
+ @param p_f
+ Position, in steps
+ 
+ @param p_d
+ Derivative, in steps per millisecond (ignored if the node generates derivatives)
+ 
+ @param p_dq
+ Number of fraction bits used to send the derivative, see keyFrames(), or
+ OM_KFB_QMASK + 1 to leave the derivative out when the node generates them
+ 
+ @return
+ Whether or not the node accepted the edit.
+ */
+
+bool OMAxis::editKeyFrame(uint8_t p_axis, unsigned int p_which, float p_x, float p_f, float p_d, uint8_t p_dq) {
+    
+    bool withDn = p_dq <= OM_KFB_QMASK;
+    uint8_t buf[1 + OM_KFE_LEN_DN];
+    uint8_t len = 0;
+    unsigned long x = p_x > 0 ? lround(p_x) : 0;
+    long f = lround(p_f);
+    
+    buf[len++] = CMD_PC_KF_EDIT;
+    buf[len++] = p_axis;
+    buf[len++] = p_which >> 8;
+    buf[len++] = p_which & 0xFF;
+    buf[len++] = withDn ? (OM_KFB_DN | p_dq) : 0;
+    buf[len++] = (x >> 24) & 0xFF;
+    buf[len++] = (x >> 16) & 0xFF;
+    buf[len++] = (x >> 8) & 0xFF;
+    buf[len++] = x & 0xFF;
+    buf[len++] = (f >> 16) & 0xFF;
+    buf[len++] = (f >> 8) & 0xFF;
+    buf[len++] = f & 0xFF;
+    
+    if( withDn ) {
+        long d = lround(p_d * ((unsigned long) 1 << p_dq));
+        d = d > 32767 ? 32767 : (d < -32768 ? -32768 : d);
+        buf[len++] = (d >> 8) & 0xFF;
+        buf[len++] = d & 0xFF;
+    }
+    
+    return ( command(m_slaveAddr, OM_PCODE_PC, (char*) buf, len) > 0 );
+}
+
+/** Feed Streamed Key Frames
+ 
+ Asks the node which key frames its streaming axes have room for, with a
+ CMD_PC_KF_NEED request, and sends them with keyFrames().  Call this regularly
+ while a streamed program plays, at least once in the time the node's window of
+ key frames takes to play, so that each axis receives its frames before it needs
+ them.
+ 
+ The arrays hold the whole program of each axis, indexed by axis.
+ 
+ @param p_axes
+ The number of axes in the arrays
+ 
+ @param p_xn
+ Key frame abscissas of each axis, in milliseconds
+ 
+ @param p_fn
+ Key frame positions of each axis, in steps
+ 
+ @param p_dn
+ Key frame derivatives of each axis, in steps per millisecond, or NULL if the node
+ generates them
+ 
+ @param p_count
+ Number of key frames of each axis
+ 
+ @param p_dq
+ Number of fraction bits used to send the derivatives, see keyFrames()
+ 
+ @param p_underruns
+ If not 0, receives the sum of the axes' underrun counts: the number of times an
+ axis needed a key frame before it arrived
+ 
+ @return
+ The number of key frames sent, or -1 if the node could not be asked or a frame
+ could not be sent
+ */
+
+int OMAxis::streamKeyFrames(uint8_t p_axes, float** p_xn, float** p_fn, float** p_dn, unsigned int* p_count, uint8_t p_dq, unsigned int* p_underruns) {
+    
+    if( p_underruns != 0 )
+        *p_underruns = 0;
+    
+    int res = command(m_slaveAddr, OM_PCODE_PC, CMD_PC_KF_NEED);
+    
+    if( res != 1 || responseType() == -1 )
+        return -1;
+    
+        // the requests are overwritten by the responses to the frames sent
+    uint8_t need[OM_SER_BUFLEN];
+    uint8_t len = responseLen() > OM_SER_BUFLEN ? OM_SER_BUFLEN : responseLen();
+    memcpy(need, responseData(), len);
+    
+    int sent = 0;
+    
+    for( uint8_t i = 0; i + OM_KFN_ENTRY <= len; i += OM_KFN_ENTRY ) {
+        
+        uint8_t axis = need[i];
+        unsigned int next = ((unsigned int) need[i + 1] << 8) | need[i + 2];
+        unsigned int room = need[i + 3];
+        
+        if( p_underruns != 0 )
+            *p_underruns += need[i + 4];
+        
+        if( axis >= p_axes || next >= p_count[axis] )
+            continue;
+        
+        if( room > p_count[axis] - next )
+            room = p_count[axis] - next;
+        
+        if( room == 0 )
+            continue;
+        
+        if( ! keyFrames(axis, next, room, p_xn[axis], p_fn[axis], p_dn != NULL ? p_dn[axis] : NULL, p_dq) )
+            return -1;
+        
+        sent += room;
+    }
+    
+    return sent;
+}
+
 /** Determine if Node is Connected and Responding
  
  Runs sends a NOOP command to the node, and determines whether or not
@@ -741,7 +1044,89 @@ bool OMAxis::comLinePulse(ComLine p_com) {
  */
 
 bool OMAxis::connected() {
-    return ( command(m_slaveAddr, OM_PCODE_PC, CMD_PC_NOOP) > 0 );
+    
+    if( command(m_slaveAddr, OM_PCODE_PC, CMD_PC_NOOP) > 0 )
+        return true;
+    
+        // the node may have been reset since its configuration was mirrored
+    invalidate();
+    return false;
+}
+
+/** Change Node Address
+ 
+ Changes the address of a node, as OMMoCoMaster::changeAddress() does, and
+ moves the configuration mirrored for the node to its new address.
+ 
+ @param p_addr
+ The current address of the node
+ 
+ @param p_newAddr
+ The new address for the node
+ 
+ @return
+ 1 if the address was changed, -1 otherwise
+ */
+
+int OMAxis::changeAddress(uint8_t p_addr, uint8_t p_newAddr) {
+    
+    int ret = OMMoCoMaster::changeAddress(p_addr, p_newAddr);
+    
+    if( ret != 1 )
+        return ret;
+    
+    OMAxisMirror* old = _cacheEntry(p_newAddr, false);
+    
+    if( old != 0 )
+        m_cacheAddr[old - m_cache] = 0;
+    
+    old = _cacheEntry(p_addr, false);
+    
+    if( old != 0 )
+        m_cacheAddr[old - m_cache] = p_newAddr;
+    
+    return ret;
+}
+
+/** Forget the Target Node's Configuration
+ 
+ OMAxis mirrors the configuration it writes to, or reads from, the
+ OM_AXIS_CACHE nodes most recently used: the interval, exposure time, maximum
+ steps, steps, backlash, camera and motor enabled, and timing master settings.
+ The matching status methods, such as getInterval(), answer from the mirror
+ without a request to the node.  A value is forgotten when a command setting it
+ fails, and all values are forgotten when connected() fails.
+ 
+ If the node's configuration may have changed by other means, for example
+ because the node was reset or another master configured it, call this method
+ so that the next status request reads the node again.
+ */
+
+void OMAxis::invalidate() {
+    invalidate(0xFFFFFFFF);
+}
+
+/** Forget Part of the Target Node's Configuration
+ 
+ Forgets the mirrored values selected by the mask, see invalidate().  If the
+ target is the broadcast address, the values are forgotten for every node.
+ 
+ @param p_mask
+ The values to forget, one bit (1UL << OM_STAT_*) each
+ */
+
+void OMAxis::invalidate(unsigned long p_mask) {
+    
+    if( m_slaveAddr == OM_SER_BCAST_ADDR ) {
+        for( uint8_t i = 0; i < OM_AXIS_CACHE; i++ )
+            m_cache[i].valid &= ~p_mask;
+        return;
+    }
+    
+    OMAxisMirror* st = _cacheEntry(m_slaveAddr, false);
+    
+    if( st != 0 )
+        st->valid &= ~p_mask;
 }
 
 
@@ -818,6 +1203,11 @@ unsigned long OMAxis::getRunTime() {
 
 
 bool OMAxis::getCamEnabled() {
+    OMAxisMirror* cached = _cacheRead(1UL << OM_STAT_CAMEN);
+    
+    if( cached != 0 )
+        return cached->camEnabled;
+    
     int res = command(m_slaveAddr, OM_PCODE_PC, CMD_PC_STATUS_REQ, OM_STAT_CAMEN);
     
     bool ret = 0;
@@ -825,6 +1215,11 @@ bool OMAxis::getCamEnabled() {
     if( res && responseType() != -1 && responseLen() > 0 ) {
         uint8_t* data = (uint8_t*) responseData();
         ret = data[0];
+        
+        OMAxisMirror* st = _cacheWrite(res > 0, 1UL << OM_STAT_CAMEN);
+        
+        if( st != 0 )
+            st->camEnabled = ret;
     }
     
     return ret;
@@ -862,6 +1257,11 @@ unsigned long OMAxis::getExposures() {
  */
 
 unsigned long OMAxis::getInterval() {
+    OMAxisMirror* cached = _cacheRead(1UL << OM_STAT_INTERVAL);
+    
+    if( cached != 0 )
+        return cached->interval;
+    
     int res = command(m_slaveAddr, OM_PCODE_PC, CMD_PC_STATUS_REQ, OM_STAT_INTERVAL);
     
     unsigned long ret = 0;
@@ -869,6 +1269,11 @@ unsigned long OMAxis::getInterval() {
     if( res && responseType() != -1 && responseLen() > 3 ) {
         uint8_t* data = (uint8_t*) responseData();
         ret = ntoul(data);
+        
+        OMAxisMirror* st = _cacheWrite(res > 0, 1UL << OM_STAT_INTERVAL);
+        
+        if( st != 0 )
+            st->interval = ret;
     }
     
     return ret;
@@ -884,6 +1289,11 @@ unsigned long OMAxis::getInterval() {
  */
 
 unsigned long OMAxis::getExposureTime() {
+    OMAxisMirror* cached = _cacheRead(1UL << OM_STAT_EXPTM);
+    
+    if( cached != 0 )
+        return cached->exposureTime;
+    
     int res = command(m_slaveAddr, OM_PCODE_PC, CMD_PC_STATUS_REQ, OM_STAT_EXPTM);
     
     unsigned long ret = 0;
@@ -891,6 +1301,11 @@ unsigned long OMAxis::getExposureTime() {
     if( res && responseType() != -1 && responseLen() > 3 ) {
         uint8_t* data = (uint8_t*) responseData();
         ret = ntoul(data);
+        
+        OMAxisMirror* st = _cacheWrite(res > 0, 1UL << OM_STAT_EXPTM);
+        
+        if( st != 0 )
+            st->exposureTime = ret;
     }
     
     return ret;
@@ -925,6 +1340,11 @@ bool OMAxis::getExposing() {
  */
 
 bool OMAxis::getMotorEnabled() {
+    OMAxisMirror* cached = _cacheRead(1UL << OM_STAT_MOTOREN);
+    
+    if( cached != 0 )
+        return cached->motorEnabled;
+    
     int res = command(m_slaveAddr, OM_PCODE_PC, CMD_PC_STATUS_REQ, OM_STAT_MOTOREN);
     
     bool ret = 0;
@@ -932,6 +1352,11 @@ bool OMAxis::getMotorEnabled() {
     if( res && responseType() != -1 && responseLen() > 0 ) {
         uint8_t* data = (uint8_t*) responseData();
         ret = data[0];
+        
+        OMAxisMirror* st = _cacheWrite(res > 0, 1UL << OM_STAT_MOTOREN);
+        
+        if( st != 0 )
+            st->motorEnabled = ret;
     }
     
     return ret;
@@ -1009,6 +1434,11 @@ long OMAxis::getHomeDistance() {
  */
 
 unsigned long OMAxis::getMaxSteps() {
+    OMAxisMirror* cached = _cacheRead(1UL << OM_STAT_MAXSTEPS);
+    
+    if( cached != 0 )
+        return cached->maxSteps;
+    
     int res = command(m_slaveAddr, OM_PCODE_PC, CMD_PC_STATUS_REQ, OM_STAT_MAXSTEPS);
     
     unsigned long ret = 0;
@@ -1016,6 +1446,11 @@ unsigned long OMAxis::getMaxSteps() {
     if( res && responseType() != -1 && responseLen() > 3 ) {
         uint8_t* data = (uint8_t*) responseData();
         ret = ntoul(data);
+        
+        OMAxisMirror* st = _cacheWrite(res > 0, 1UL << OM_STAT_MAXSTEPS);
+        
+        if( st != 0 )
+            st->maxSteps = ret;
     }
     
     return ret;        
@@ -1028,13 +1463,23 @@ unsigned long OMAxis::getMaxSteps() {
  */
 
 uint8_t OMAxis::getBacklash() {
+    OMAxisMirror* cached = _cacheRead(1UL << OM_STAT_BACKLASH);
+    
+    if( cached != 0 )
+        return cached->backlash;
+    
     int res = command(m_slaveAddr, OM_PCODE_PC, CMD_PC_STATUS_REQ, OM_STAT_BACKLASH);
     
-    bool ret = 0;
+    uint8_t ret = 0;
     
     if( res && responseType() != -1 && responseLen() > 0 ) {
         uint8_t* data = (uint8_t*) responseData();
         ret = data[0];
+        
+        OMAxisMirror* st = _cacheWrite(res > 0, 1UL << OM_STAT_BACKLASH);
+        
+        if( st != 0 )
+            st->backlash = ret;
     }
     
     return ret;
@@ -1048,6 +1493,11 @@ uint8_t OMAxis::getBacklash() {
  */
 
 unsigned int OMAxis::getSteps() {
+    OMAxisMirror* cached = _cacheRead(1UL << OM_STAT_STEPS);
+    
+    if( cached != 0 )
+        return cached->steps;
+    
     int res = command(m_slaveAddr, OM_PCODE_PC, CMD_PC_STATUS_REQ, OM_STAT_STEPS);
     
     unsigned int ret = 0;
@@ -1055,6 +1505,11 @@ unsigned int OMAxis::getSteps() {
     if( res && responseType() != -1 && responseLen() > 1 ) {
         uint8_t* data = (uint8_t*) responseData();
         ret = ntoui(data);
+        
+        OMAxisMirror* st = _cacheWrite(res > 0, 1UL << OM_STAT_STEPS);
+        
+        if( st != 0 )
+            st->steps = ret;
     }
     
     return ret;        
@@ -1067,6 +1522,11 @@ unsigned int OMAxis::getSteps() {
  Timing master value
  */
 bool OMAxis::getMaster() {
+    OMAxisMirror* cached = _cacheRead(1UL << OM_STAT_MASTER);
+    
+    if( cached != 0 )
+        return cached->master;
+    
     int res = command(m_slaveAddr, OM_PCODE_PC, CMD_PC_STATUS_REQ, OM_STAT_MASTER);
     
     bool ret = 0;
@@ -1074,13 +1534,405 @@ bool OMAxis::getMaster() {
     if( res && responseType() != -1 && responseLen() > 0 ) {
         uint8_t* data = (uint8_t*) responseData();
         ret = data[0];
+        
+        OMAxisMirror* st = _cacheWrite(res > 0, 1UL << OM_STAT_MASTER);
+        
+        if( st != 0 )
+            st->master = ret;
     }
     
     return ret;    
 }
 
+/** Status: Subscribe to Status Telemetry
+ 
+ Asks the target node to send the status values selected by the mask as a
+ telemetry frame, at most once every period, instead of having each value
+ polled with its own request.  Frames are requested with telemetry() and
+ collected with telemetryPoll() or telemetryWait(), and can be decoded with
+ unpackStatus() in the telemetry handler.
+ 
+ For example:
+ 
+ @code
+ const unsigned long fields = (1UL << OM_STAT_RUN) | (1UL << OM_STAT_MOVED);
+ 
+ void onFrame(byte addr, byte* data, byte len) {
+    OMAxisStatus status;
+    if( Axis.unpackStatus(fields, data, len, status) && ! status.running )
+        ...
+ }
+ 
+ Axis.telemetryHandler(onFrame);
+ Axis.target(3);
+ Axis.subscribeStatus(fields, 250, 0);
+ 
+ unsigned long last = 0;
+ 
+ while( true ) {
+    if( millis() - last >= 250 && Axis.telemetry(1) )
+        last = millis();
+    Axis.telemetryPoll();
+    ...
+ }
+ @endcode
+ 
+ See OMMoCoMaster::subscribe() for how slots are assigned.  A frame holds at
+ most OM_SER_SLOT_DATA - 1 bytes of values, each the size it has as a status
+ response, and the node refuses a mask needing more.
+ 
+ @param p_mask
+ The status values wanted, one bit (1UL << OM_STAT_*) each, or 0 to stop
+ 
+ @param p_period
+ The least time between frames, in milliseconds
+ 
+ @param p_slot
+ The response slot for the node's frames
+ 
+ @return
+ Whether or not the node accepted the subscription
+ */
+
+bool OMAxis::subscribeStatus(unsigned long p_mask, unsigned int p_period, uint8_t p_slot) {
+    return ( subscribe(m_slaveAddr, p_mask, p_period, p_slot) == 1 );
+}
+
+/** Status: Decode a Status Frame
+ 
+ Decodes a status frame holding the values selected by the mask, see
+ subscribeStatus().  Each value decoded is stored in the status and its bit
+ set in status.valid.
+ 
+ @param p_mask
+ The status values the frame holds, one bit (1UL << OM_STAT_*) each
+ 
+ @param p_data
+ The frame data
+ 
+ @param p_len
+ The frame length
+ 
+ @param p_status
+ The status to decode into
+ 
+ @return
+ Whether or not the whole frame was decoded
+ */
+
+bool OMAxis::unpackStatus(unsigned long p_mask, uint8_t* p_data, uint8_t p_len, OMAxisStatus& p_status) {
+    
+    p_status.valid = 0;
+    
+    return _unpackStatus(p_mask, p_data, p_len, p_status);
+}
+
+/** Status: Refresh All Status Values
+ 
+ Reads every status value from the target node into the status, see
+ refreshStatus(OMAxisStatus&, unsigned long).
+ 
+ @param p_status
+ The status to fill
+ 
+ @return
+ Whether or not every value was received
+ */
+
+bool OMAxis::refreshStatus(OMAxisStatus& p_status) {
+    return refreshStatus(p_status, OM_STAT_ALL);
+}
+
+/** Status: Refresh Status Values
+ 
+ Reads the status values selected by the mask from the target node into the
+ status, with one bulk status request instead of one request per value.  Each
+ value received has its bit set in status.valid.
+ 
+ A response holds at most OM_SER_BUFLEN - 1 bytes of status, so a mask
+ selecting more is split over as few requests as needed: with the default
+ buffer length, all status values take two requests.
+ 
+ For example:
+ 
+ @code
+ OMAxisStatus status;
+ 
+ if( Axis.refreshStatus(status, (1UL << OM_STAT_RUN) | (1UL << OM_STAT_SHOTS)) ) {
+    Serial.println(status.running);
+    Serial.println(status.exposures);
+ }
+ @endcode
+ 
+ @param p_status
+ The status to fill
+ 
+ @param p_mask
+ The status values wanted, one bit (1UL << OM_STAT_*) each
+ 
+ @return
+ Whether or not every value was received
+ */
+
+bool OMAxis::refreshStatus(OMAxisStatus& p_status, unsigned long p_mask) {
+    
+    p_status.valid = 0;
+    
+    unsigned long mask = 0;
+    uint8_t len = 0;
+    
+    for( uint8_t code = 0; code < 32; code++ ) {
+        
+        if( ! (p_mask & (1UL << code)) )
+            continue;
+        
+        uint8_t size = _statusSize(code);
+        
+        if( size == 0 )
+            return false;
+        
+            // request what fits so far, when the next value would not
+        if( len + size > OM_SER_BUFLEN - 1 ) {
+            if( ! _statusBulk(mask, p_status) )
+                return false;
+            
+            mask = 0;
+            len = 0;
+        }
+        
+        mask |= 1UL << code;
+        len += size;
+    }
+    
+    if( mask != 0 && ! _statusBulk(mask, p_status) )
+        return false;
+    
+    _cacheStatus(p_status);
+    return true;
+}
+
 /** 
  
  @} */
 
+// request the status values of a mask with one bulk status request, and
+// decode them into the status
+
+bool OMAxis::_statusBulk(unsigned long p_mask, OMAxisStatus& p_status) {
+    
+    uint8_t buf[5];
+    
+    buf[0] = CMD_PC_STATUS_BULK;
+    buf[1] = p_mask >> 24;
+    buf[2] = p_mask >> 16;
+    buf[3] = p_mask >> 8;
+    buf[4] = p_mask;
+    
+    int res = command(m_slaveAddr, OM_PCODE_PC, (char*) buf, 5);
+    
+    if( res != 1 || responseType() == -1 )
+        return false;
+    
+    return _unpackStatus(p_mask, (uint8_t*) responseData(), responseLen(), p_status);
+}
+
+// decode the status values of a mask from a status frame, adding them to
+// those already in the status
+
+bool OMAxis::_unpackStatus(unsigned long p_mask, uint8_t* p_data, uint8_t p_len, OMAxisStatus& p_status) {
+    
+    uint8_t pos = 0;
+    
+    for( uint8_t code = 0; code < 32; code++ ) {
+        
+        if( ! (p_mask & (1UL << code)) )
+            continue;
+        
+        uint8_t size = _statusSize(code);
+        
+        if( size == 0 || pos + size > p_len )
+            return false;
+        
+        uint8_t* data = p_data + pos;
+        
+        switch( code ) {
+            case OM_STAT_FWVER:
+                p_status.fwVersion = data[0];
+                break;
+            case OM_STAT_RUN:
+                p_status.running = data[0];
+                break;
+            case OM_STAT_RUNTIME:
+                p_status.runTime = ntoul(data);
+                break;
+            case OM_STAT_CAMEN:
+                p_status.camEnabled = data[0];
+                break;
+            case OM_STAT_SHOTS:
+                p_status.exposures = ntoul(data);
+                break;
+            case OM_STAT_INTERVAL:
+                p_status.interval = ntoul(data);
+                break;
+            case OM_STAT_EXPTM:
+                p_status.exposureTime = ntoul(data);
+                break;
+            case OM_STAT_EXPOSING:
+                p_status.exposing = data[0];
+                break;
+            case OM_STAT_MOTOREN:
+                p_status.motorEnabled = data[0];
+                break;
+            case OM_STAT_MOTORDIR:
+                p_status.motorDir = data[0];
+                break;
+            case OM_STAT_MOVED:
+                p_status.stepsMoved = ntoul(data);
+                break;
+            case OM_STAT_HOMEDIST:
+                p_status.homeDistance = ntol(data);
+                break;
+            case OM_STAT_MAXSTEPS:
+                p_status.maxSteps = ntoul(data);
+                break;
+            case OM_STAT_BACKLASH:
+                p_status.backlash = data[0];
+                break;
+            case OM_STAT_STEPS:
+                p_status.steps = ntoui(data);
+                break;
+            case OM_STAT_MASTER:
+                p_status.master = data[0];
+                break;
+        }
+        
+        p_status.valid |= 1UL << code;
+        pos += size;
+    }
+    
+    return ( pos == p_len );
+}
+
+// find the mirror of a node's configuration, or assign it the least recently
+// assigned mirror. returns 0 if the node has none
+
+OMAxisMirror* OMAxis::_cacheEntry(uint8_t p_addr, bool p_add) {
+    
+    for( uint8_t i = 0; i < OM_AXIS_CACHE; i++ ) {
+        if( m_cacheAddr[i] == p_addr && p_addr != 0 )
+            return &m_cache[i];
+    }
+    
+    if( ! p_add )
+        return 0;
+    
+    uint8_t entry = m_cacheNext;
+    m_cacheNext = (m_cacheNext + 1) % OM_AXIS_CACHE;
+    
+    m_cacheAddr[entry] = p_addr;
+    m_cache[entry].valid = 0;
+    
+    return &m_cache[entry];
+}
+
+// the target's mirror, if it holds a value for the field. a request which
+// would be queued, pipelined or bundled is always sent, so that its result is
+// delivered as any other deferred command's is
+
+OMAxisMirror* OMAxis::_cacheRead(unsigned long p_field) {
+    
+    if( deferred() )
+        return 0;
+    
+    OMAxisMirror* st = _cacheEntry(m_slaveAddr, false);
+    
+    if( st == 0 || ! (st->valid & p_field) )
+        return 0;
+    
+    return st;
+}
+
+// mark a field of the target's mirror as holding the node's value, if the
+// command writing or reading it succeeded, and return the mirror for the value
+// to be stored. a bundled or pipelined command has not been executed yet, so
+// the field is forgotten instead, as it is by every node's mirror when the
+// target is the broadcast address
+
+OMAxisMirror* OMAxis::_cacheWrite(bool p_ok, unsigned long p_field) {
+    
+    if( ! p_ok || deferred() || m_slaveAddr == OM_SER_BCAST_ADDR ) {
+        invalidate(p_field);
+        return 0;
+    }
+    
+    OMAxisMirror* st = _cacheEntry(m_slaveAddr, true);
+    st->valid |= p_field;
+    
+    return st;
+}
+
+// mirror the configuration values of a status read from the target, leaving
+// the mirrored values the status does not hold as they were
+
+void OMAxis::_cacheStatus(OMAxisStatus& p_status) {
+    
+    unsigned long fields = p_status.valid & ( (1UL << OM_STAT_CAMEN) | (1UL << OM_STAT_INTERVAL) |
+        (1UL << OM_STAT_EXPTM) | (1UL << OM_STAT_MOTOREN) | (1UL << OM_STAT_MAXSTEPS) |
+        (1UL << OM_STAT_BACKLASH) | (1UL << OM_STAT_STEPS) | (1UL << OM_STAT_MASTER) );
+    
+    if( fields == 0 )
+        return;
+    
+    OMAxisMirror* st = _cacheWrite(true, fields);
+    
+    if( st == 0 )
+        return;
+    
+    if( fields & (1UL << OM_STAT_CAMEN) )
+        st->camEnabled = p_status.camEnabled;
+    if( fields & (1UL << OM_STAT_INTERVAL) )
+        st->interval = p_status.interval;
+    if( fields & (1UL << OM_STAT_EXPTM) )
+        st->exposureTime = p_status.exposureTime;
+    if( fields & (1UL << OM_STAT_MOTOREN) )
+        st->motorEnabled = p_status.motorEnabled;
+    if( fields & (1UL << OM_STAT_MAXSTEPS) )
+        st->maxSteps = p_status.maxSteps;
+    if( fields & (1UL << OM_STAT_BACKLASH) )
+        st->backlash = p_status.backlash;
+    if( fields & (1UL << OM_STAT_STEPS) )
+        st->steps = p_status.steps;
+    if( fields & (1UL << OM_STAT_MASTER) )
+        st->master = p_status.master;
+}
+
+// size in bytes of a status value, 0 for an unknown status code
+
+uint8_t OMAxis::_statusSize(uint8_t p_code) {
+    
+    switch( p_code ) {
+        case OM_STAT_FWVER:
+        case OM_STAT_RUN:
+        case OM_STAT_CAMEN:
+        case OM_STAT_EXPOSING:
+        case OM_STAT_MOTOREN:
+        case OM_STAT_MOTORDIR:
+        case OM_STAT_BACKLASH:
+        case OM_STAT_MASTER:
+            return 1;
+        case OM_STAT_STEPS:
+            return 2;
+        case OM_STAT_RUNTIME:
+        case OM_STAT_SHOTS:
+        case OM_STAT_INTERVAL:
+        case OM_STAT_EXPTM:
+        case OM_STAT_MOVED:
+        case OM_STAT_HOMEDIST:
+        case OM_STAT_MAXSTEPS:
+            return 4;
+    }
+    
+    return 0;
+}
+
 
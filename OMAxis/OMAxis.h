@@ -32,6 +32,11 @@
 
 #include "../OMMoCoMaster/OMMoCoMaster.h"
 
+// number of nodes whose configuration OMAxis mirrors. Each OMAxis holds the
+// mirrors itself, so a sketch cannot change this without the library's own
+// files seeing a different class
+#define OM_AXIS_CACHE 4
+
 /** @file OMAxis.h 
  
  Header file for OMAxis class
@@ -85,6 +90,41 @@ enum ComLine {
     
 };
 
+/** Status of a nanoMoCo Device, as Received in a Status Frame */
+struct OMAxisStatus {
+        /** Fields received, one bit (1UL << OM_STAT_*) for each */
+    unsigned long valid;
+    uint8_t fwVersion;
+    bool running;
+    unsigned long runTime;
+    bool camEnabled;
+    unsigned long exposures;
+    unsigned long interval;
+    unsigned long exposureTime;
+    bool exposing;
+    bool motorEnabled;
+    bool motorDir;
+    unsigned long stepsMoved;
+    long homeDistance;
+    unsigned long maxSteps;
+    uint8_t backlash;
+    unsigned int steps;
+    bool master;
+};
+
+// the configuration values OMAxis mirrors for a node, valid as for OMAxisStatus
+struct OMAxisMirror {
+    unsigned long valid;
+    unsigned long interval;
+    unsigned long exposureTime;
+    unsigned long maxSteps;
+    unsigned int steps;
+    uint8_t backlash;
+    bool camEnabled;
+    bool motorEnabled;
+    bool master;
+};
+
 /** 
  
  @brief Complete control of nanoMoCo Devices on MoCoBus
@@ -190,11 +230,18 @@ public:
     bool delayMoveStart(unsigned long p_ms);
     bool maxRunTime(unsigned long p_ms);
     bool comLinePulse(ComLine p_com);
+    bool keyFrames(uint8_t p_axis, unsigned int p_first, unsigned int p_count, float* p_xn, float* p_fn, float* p_dn, uint8_t p_dq);
+    bool editKeyFrame(uint8_t p_axis, unsigned int p_which, float p_x, float p_f, float p_d, uint8_t p_dq);
+    int streamKeyFrames(uint8_t p_axes, float** p_xn, float** p_fn, float** p_dn, unsigned int* p_count, uint8_t p_dq, unsigned int* p_underruns = 0);
 
     void target(uint8_t p_addr);
     uint8_t target();
 
     bool connected();
+    int changeAddress(uint8_t p_addr, uint8_t p_newAddr);
+    
+    void invalidate();
+    void invalidate(unsigned long p_mask);
     
     // status requests
     
@@ -215,12 +262,31 @@ public:
     unsigned int getSteps();
     bool getMaster();
     
+    bool subscribeStatus(unsigned long p_mask, unsigned int p_period, uint8_t p_slot);
+    bool unpackStatus(unsigned long p_mask, uint8_t* p_data, uint8_t p_len, OMAxisStatus& p_status);
+    bool refreshStatus(OMAxisStatus& p_status);
+    bool refreshStatus(OMAxisStatus& p_status, unsigned long p_mask);
+    
 
 
 private:
     // internal data
     uint8_t m_slaveAddr;
     
+    // configuration last written to, or read from, recently used nodes
+    uint8_t m_cacheNext;
+    uint8_t m_cacheAddr[OM_AXIS_CACHE];
+    OMAxisMirror m_cache[OM_AXIS_CACHE];
+    
+    OMAxisMirror* _cacheEntry(uint8_t p_addr, bool p_add);
+    OMAxisMirror* _cacheRead(unsigned long p_field);
+    OMAxisMirror* _cacheWrite(bool p_ok, unsigned long p_field);
+    void _cacheStatus(OMAxisStatus& p_status);
+    
+    uint8_t _statusSize(uint8_t p_code);
+    bool _statusBulk(unsigned long p_mask, OMAxisStatus& p_status);
+    bool _unpackStatus(unsigned long p_mask, uint8_t* p_data, uint8_t p_len, OMAxisStatus& p_status);
+    
 
 
 };
@@ -559,6 +625,60 @@ private:
  
  @endcode
  
+ Each 'get' method is a separate request.  To read several values at once, for example to refresh a display
+ of every axis, use refreshStatus(), which fetches the values selected by a mask in a single request, and
+ reports whether they were received:
+ 
+ @code
+ 
+ OMAxisStatus status;
+ 
+ if( Axis.refreshStatus(status) ) {
+    unsigned long runTime = status.runTime;
+ }
+ 
+ @endcode
+ 
+ To have a node send its status regularly without being asked each time, see subscribeStatus().
+ 
+ @section nmasync Commands Without Waiting
+ 
+ Each OMAxis method normally waits for the node's response, which can take up to the response timeout, and longer
+ when a lost command is retried, if a node is slow or absent.  A master which must keep servicing a menu or its own
+ motion meanwhile can have the commands queued instead, with asyncBegin(), and their results delivered to a callback
+ as they complete.  Any OMAxis method called between asyncBegin() and asyncEnd() returns at once, its command queued,
+ and asyncHandle() gives the handle identifying its result.  Calling asyncPoll() regularly keeps the queued commands
+ moving over the bus.
+ 
+ @code
+ 
+ void onDone(byte handle, byte addr, int code) {
+    if( code < 0 )
+       showError(addr);
+ }
+ 
+ Axis.asyncHandler(onDone);
+ Axis.asyncBegin();
+ Axis.target(4);
+ Axis.interval(5000);
+ Axis.target(5);
+ Axis.interval(5000);
+ Axis.asyncEnd();
+ 
+ void loop() {
+    Axis.asyncPoll();
+    updateMenu();
+ }
+ 
+ @endcode
+ 
+ A queued command's result is not known when the method returns, so command methods return true once the command is
+ queued, and 'get' methods return 0.  The value requested is read in the callback, with responseData(), or a result
+ can be checked later with asyncResult(), which returns OM_SER_PENDING until the command completes.  Values set by
+ queued commands are not mirrored (see invalidate()), and are read from the node the next time they are requested.
+ Nor are mirrored values answered while queuing: every 'get' method queues its request, so each call has a handle and
+ a callback.
+ 
  @section nmsucfail Success and Failure of Communication
  
  All communication over MoCoBus, except broadcast commands, is validated.  That is to say, when a command is sent to a node,
@@ -65,8 +65,12 @@ const uint8_t CMD_PC_CLEAR_PLAN        = 21;
 const uint8_t CMD_PC_MAX_RUN           = 22;
 const uint8_t CMD_PC_NAME              = 23;
 const uint8_t CMD_PC_COMLINE           = 24;
+const uint8_t CMD_PC_KF_BULK           = 25;
+const uint8_t CMD_PC_KF_NEED           = 26;
+const uint8_t CMD_PC_KF_EDIT           = 27;
 
 const uint8_t CMD_PC_STATUS_REQ        = 100;
+const uint8_t CMD_PC_STATUS_BULK       = 101;
 
     // status request codes
 
@@ -87,6 +91,43 @@ const uint8_t OM_STAT_BACKLASH  = 16;
 const uint8_t OM_STAT_STEPS     = 17;
 const uint8_t OM_STAT_MASTER    = 22;
 
+    // every status value, as a field mask
+const unsigned long OM_STAT_ALL = (1UL << OM_STAT_FWVER) | (1UL << OM_STAT_RUN) | (1UL << OM_STAT_RUNTIME) |
+    (1UL << OM_STAT_CAMEN) | (1UL << OM_STAT_SHOTS) | (1UL << OM_STAT_INTERVAL) | (1UL << OM_STAT_EXPTM) |
+    (1UL << OM_STAT_EXPOSING) | (1UL << OM_STAT_MOTOREN) | (1UL << OM_STAT_MOTORDIR) | (1UL << OM_STAT_MOVED) |
+    (1UL << OM_STAT_HOMEDIST) | (1UL << OM_STAT_MAXSTEPS) | (1UL << OM_STAT_BACKLASH) | (1UL << OM_STAT_STEPS) |
+    (1UL << OM_STAT_MASTER);
+
+    // status frames, as sent for telemetry and in answer to CMD_PC_STATUS_BULK
+    // (followed by a 4-byte field mask): each status value whose bit
+    // (1UL << OM_STAT_*) is set in the field mask, in ascending order of status
+    // code, big-endian in the size it has as a status response
+
+
+    // key frame bulk upload format: axis, first frame (2 bytes), frame count and
+    // format byte, followed by each frame's abscissa delta in ms (2 bytes), position
+    // in steps (signed, 3 bytes) and, if OM_KFB_DN is set, derivative (signed, 2 bytes,
+    // format & OM_KFB_QMASK fraction bits). All values are big-endian.
+
+const uint8_t OM_KFB_DN       = 0x80;
+const uint8_t OM_KFB_QMASK    = 0x1F;
+const uint8_t OM_KFB_HEADER   = 5;
+const uint8_t OM_KFB_FRAME    = 5;
+const uint8_t OM_KFB_FRAME_DN = 7;
+
+    // key frame stream request response: for each streaming axis wanting frames,
+    // axis, next frame expected (2 bytes, big-endian), room in frames and underrun
+    // count (both saturated at 255)
+
+const uint8_t OM_KFN_ENTRY    = 5;
+
+    // key frame edit format: axis, frame (2 bytes) and format byte as for a bulk
+    // upload, followed by the abscissa in ms (4 bytes), position in steps (signed,
+    // 3 bytes) and, if OM_KFB_DN is set, derivative (signed, 2 bytes)
+
+const uint8_t OM_KFE_LEN      = 11;
+const uint8_t OM_KFE_LEN_DN   = 13;
+
     // data setting
 
 const uint8_t OM_PCODE_PDS = 3;
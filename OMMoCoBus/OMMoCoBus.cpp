@@ -66,6 +66,40 @@ OMMoCoBus::OMMoCoBus(Stream * c_serObj) {
   m_devAddr = c_dAddr;
   m_bufSize = 0;
   f_newAddr = 0;
+  m_rxState = OM_SER_RX_SYNC;
+  m_rxPos = 0;
+  m_rxCount = 0;
+  m_rxCode = 0;
+  m_rxLen = 0;
+  m_rxTime = 0;
+  m_rxDone = 0;
+  m_rxProto = OM_SER_V1;
+  m_rxSeq = 0;
+  m_rxCrc = 0;
+  m_rxCorrupt = false;
+  m_txLen = 0;
+  m_txEnd = 0;
+  m_txLast = 0;
+  m_txWhole = false;
+  m_txProto = OM_SER_V1;
+  m_txSeq = 0;
+  m_txCrc = 0;
+  m_txZeros = 0;
+  m_txStuff = false;
+  m_rxZeros = 0;
+  m_rxSlotted = false;
+  m_rxSlot = OM_SER_NO_SLOT;
+  m_txSlot = OM_SER_NO_SLOT;
+  m_txHold = false;
+  m_txHeld = false;
+  m_txDrop = false;
+  m_capOn = false;
+  m_capBuf = 0;
+  m_capSize = 0;
+  m_capLen = 0;
+  m_capCode = 0;
+  m_capOk = false;
+  m_capAddr = 0;
 
 
   pinMode(OMB_DEPIN, OUTPUT);
@@ -147,7 +181,10 @@ void OMMoCoBus::addressCallback(void(*p_Func)(uint8_t)) {
  packet has been received from the bus.
 
  WARNING: This method returns a pointer to the -actual- buffer. Do not store
- this pointer between packets or attempt to modify it directly.
+ this pointer between packets or attempt to modify it directly.  Incoming
+ payload bytes are read straight into this buffer, so its contents are only
+ valid until the next call to getPacket(), and bytes beyond bufferLen() are
+ left over from earlier packets rather than cleared.
 
  Check OM_SER_BUFLEN constant for maximum buffer length.
 
@@ -247,26 +284,6 @@ float OMMoCoBus::ntof(uint8_t* p_dat) {
 	return(ret);
 }
 
-/** Retrieve Packet Data Buffer
-
- Retrieves the complete packet data buffer (without the packet header) after a
- packet has been received from the bus.
-
- WARNING: This method returns a pointer to the -actual- buffer. Do not store
- this pointer between packets or attempt to modify it directly.
-
- Check OM_SER_BUFLEN constant for maximum buffer length.
-
- @return
- Pointer to entire packet data
- */
-/*
-uint8_t* OMMoCoBus::packet() {
-   return(m_incomingPacket);
-}
-*/
-
-
  // end public group
 
 /**
@@ -285,9 +302,19 @@ uint8_t* OMMoCoBus::packet() {
 
  Gets a complete packet off of the bus, if available.
 
- If there is a complete packet received over the bus, and if it is destined
- for this device, this method will place the packet data into the buffer
- and return the packet code.
+ This method never waits for serial data: it consumes only the bytes already
+ received, one at a time, and returns immediately.  A packet is assembled over
+ as many calls as it takes to arrive, and once its last byte has been read
+ the packet data is placed into the buffer and the packet code returned.  If
+ nothing is waiting to be read and more than OM_SER_WAIT milliseconds have
+ passed since the last byte of a packet was read, the partial packet is
+ discarded and the parser waits for the next break sequence.  Bytes already
+ received are always read first, so a sketch busy for longer than OM_SER_WAIT
+ does not lose a packet sitting in the serial buffer.
+
+ Packets in both framing versions are accepted, see packetProtocol().  A version
+ 2 packet failing its CRC is discarded, 0 is returned and packetCorrupt() returns
+ true until the next call.
 
  Note: this method is not intended for direct use in Nodes, instead see
  OMMoCoNode::check() which is the correct way to check for a received
@@ -300,118 +327,123 @@ uint8_t* OMMoCoBus::packet() {
 
 uint8_t OMMoCoBus::getPacket() {
 
-    uint8_t command_val    = 0;
-    uint8_t com_byte_count = 0;
-    uint8_t ret            = 0;
-	uint8_t len			   = 0; // Length of the data section of the packet
-
-    m_isBCast = false;
-
-    m_notUs = false;
-
-	// we check serial.available() here even
-    // though this->_getNextByte() does, because
-    // a timeout is applied waiting for next command
-    // in this->_getNextByte() - since this is called
-    // every cycle of the main loop, we don't want
-    // to introduce a delay unless we know of a
-    // byte waiting to be read
-
-    int avail = m_serObj->available();
-
-    // serial does not have data in the buffer
-    if( avail <= 0 )
-        return(0);
-
-	// clear out any previous data in the packet array
-	memset(m_incomingPacket, 0, sizeof(uint8_t)* (OM_SER_PKT_PREAMBLE + OM_SER_BUFLEN));
+	// a partial packet whose bytes stopped arriving is abandoned, so that a
+	// node which lost bytes resynchronizes on the next break sequence. Its
+	// data may already have overwritten the buffer, so no length is reported.
+	// m_rxTime is when the last byte was read, not when it arrived, so only
+	// an empty receive buffer shows that the bytes really stopped
+	if( m_rxState != OM_SER_RX_SYNC && m_serObj->available() == 0 && millis() - m_rxTime > OM_SER_WAIT ) {
+		m_rxState = OM_SER_RX_SYNC;
+		m_rxPos = 0;
+		m_bufSize = 0;
+	}
 
-	// Get the first section of the packet, including header, subaddress,
-	// address, packet code, and data packet data length
-	for (byte i = 0; i < OM_SER_PKT_PREAMBLE; i++)
-	{
-		ret = this->_getNextByte(m_incomingPacket[i]);
+	// a corrupted packet is only reported by the call which read it
+	m_rxCorrupt = false;
+
+	// consume only what the serial object has already received, never
+	// waiting for more - an incomplete packet is continued on the next call
+	while( m_serObj->available() > 0 ) {
+
+		uint8_t dat = (uint8_t) m_serObj->read();
+		m_rxTime = millis();
+
+		if( m_rxState == OM_SER_RX_SYNC ) {
+			// m_rxPos counts the nulls of the break sequence seen so far,
+			// the byte ending the sequence gives the packet framing
+			if( dat == 0 ) {
+				if( m_rxPos < OM_SER_BREAK_LEN )
+					m_rxPos++;
+			}
+			else if( ( dat == OM_SER_BREAK_V1 || dat == OM_SER_BREAK_V2 || dat == OM_SER_BREAK_SLOT ) && m_rxPos == OM_SER_BREAK_LEN ) {
+				m_rxProto = ( dat == OM_SER_BREAK_V1 ) ? OM_SER_V1 : OM_SER_V2;
+				m_rxSlotted = ( dat == OM_SER_BREAK_SLOT );
+				m_rxCrc = OM_SER_CRC_INIT;
+				m_rxZeros = 0;
+				m_rxPos = OM_SER_BREAK_LEN + 1;
+				m_rxState = OM_SER_RX_HEAD;
+			}
+			else {
+				m_rxPos = 0;
+			}
+
+			continue;
+		}
 
-		if (ret != OM_SER_OK) {
-			// well, this is just embarassing
-			this->_flushSerial();
-			return(0);
+		if( m_rxProto == OM_SER_V2 ) {
+			// version 2 senders follow every run of OM_SER_ESC_RUN nulls with
+			// OM_SER_ESC, so a packet never holds a break sequence
+			if( m_rxZeros == OM_SER_ESC_RUN ) {
+				m_rxZeros = 0;
+
+				if( dat == OM_SER_ESC )
+					continue;
+
+				// anything else means bytes were lost - a further null can only
+				// be part of a new break sequence, so resynchronize on it
+				m_rxCorrupt = true;
+				m_rxPos = ( dat == 0 ) ? OM_SER_ESC_RUN + 1 : 0;
+				m_rxState = OM_SER_RX_SYNC;
+				m_bufSize = 0;
+				continue;
+			}
+
+			if( dat == 0 )
+				m_rxZeros++;
+			else
+				m_rxZeros = 0;
+
+			// the CRC covers everything after the break sequence, including
+			// the CRC its self, which leaves a remainder of zero
+			m_rxCrc = crc16(m_rxCrc, dat);
 		}
-	}
 
-    // Check the data length and then save the rest of the packet
-    len = m_incomingPacket[LEN_POS];
+		if( m_rxState == OM_SER_RX_HEAD ) {
+			// the header is kept only as the fields it carries
+			if( m_rxPos == OM_SER_ADDR_POS )
+				addr = dat;
+			else if( m_rxPos == OM_SER_ADDR_POS + 1 )
+				subaddr = dat;
+			else if( m_rxPos == COM_POS )
+				m_rxCode = dat;
+			else if( m_rxPos == LEN_POS )
+				m_rxLen = dat;
+			else if( m_rxPos == OM_SER_PKT_PREAMBLE )
+				m_rxSeq = dat;
+			else
+				m_rxSlot = dat;
+
+			if( ++m_rxPos == OM_SER_PKT_PREAMBLE + ( m_rxProto == OM_SER_V2 ? 1 : 0 ) + ( m_rxSlotted ? 1 : 0 ) ) {
+				m_rxCount = 0;
+				m_rxState = OM_SER_RX_DATA;
+			}
+		}
+		else if( m_rxState == OM_SER_RX_DATA ) {
+			// the payload is read straight into the data buffer,
+			// discarding anything that won't fit
+			if( m_rxCount < OM_SER_BUFLEN )
+				m_serBuffer[m_rxCount] = dat;
 
+			m_rxCount++;
+		}
+		else {
+			m_rxPos++;
+		}
 
-	// Get the rest of the packet data
-	for (byte i = DATA_POS; i < (DATA_POS + len); i++)
-	{
-		ret = this->_getNextByte(m_incomingPacket[i]);
+		// version 2 packets continue with the CRC once the data is complete
+		if( m_rxState == OM_SER_RX_DATA && m_rxCount == m_rxLen ) {
+			if( m_rxProto != OM_SER_V2 )
+				return( this->_endPacket() );
 
-		if (ret != OM_SER_OK) {
-			// well, this is just embarassing
-			this->_flushSerial();
-			return(0);
+			m_rxPos = 0;
+			m_rxState = OM_SER_RX_CRC;
+		}
+		else if( m_rxState == OM_SER_RX_CRC && m_rxPos == OM_SER_CRC_LEN ) {
+			return( this->_endPacket() );
 		}
 	}
 
-	// is this packet intended for us?
-    uint8_t stat = this->_targetUs();
-
-    if(stat == OM_SER_ERR || stat == OM_SER_TIMEOUT) {
-        // got an error? timeout error, really.
-        this->_flushSerial();
-        return(0);
-    }
-    else if( stat == OM_SER_IS_BCAST ) {
-        // command was a broadcast command
-        m_isBCast = true;
-    }
-    else if( stat != OM_SER_OK ) {
-        // command was for someone else
-        // (but we need to read the rest of the data
-        // off the line to make sure we don't keep part of it
-        // in the buffer)
-        m_notUs = true;
-	}
-
-	this->_flushSerial();
-
-	// Save the command byte from the packet array
-	command_val = m_incomingPacket[COM_POS];
-
-
-    // check for overflow
-    // note: we will still be in error condition, as
-    // there will be values left in the serial buffer
-    // on the next read, from this command - so don't
-    // exceed it, eh?  This is just to prevent memory
-    // corruption.  It is not safe otherwise
-
-    if(com_byte_count > OM_SER_BUFLEN)
-        com_byte_count = OM_SER_BUFLEN;
-
-
-    // clear out any previous command data
-    memset(m_serBuffer, 0, sizeof(uint8_t) * OM_SER_BUFLEN);
-    m_bufSize = 0;
-
-
-    // populate command data buffer
-    for( int i = 0; i < len; i++ ) {
-        // get com_byte_count character values from the serial
-        // buffer
-		m_serBuffer[i] = m_incomingPacket[DATA_POS + i];
-        m_bufSize++;
-    }
-/*
-    if( m_notUs == true ) {
-        // the command was not intended for us
-        memset(m_serBuffer, 0, sizeof(uint8_t) * OM_SER_BUFLEN);
-    }
-
-*/
-    return( command_val );
+	return(0);
 }
 
 
@@ -467,6 +499,10 @@ uint8_t OMMoCoBus::getPacket() {
  Note that all multi-byte values sent using the MoCoBus specification are in
  Big-Endian (Network) byte order!
 
+ The header and the data written after it are collected in a transmit buffer,
+ and the packet is put on the bus as a whole as soon as p_dlen data bytes have
+ been written (see write()).
+
  There are two types of packets which may be sent on MoCoBus, and they are not
  differentiated except in the order in which they occur:
 
@@ -504,18 +540,57 @@ uint8_t OMMoCoBus::getPacket() {
 
 void OMMoCoBus::sendPacketHeader(uint8_t p_addr, uint8_t p_subaddr, uint8_t p_code, uint8_t p_dlen) {
 
+	// while capturing, the packet is recorded rather than sent
+	if( m_capOn ) {
+		m_capCode = p_code;
+		m_capOk = ( p_addr == m_capAddr && m_capLen + 2 + p_dlen <= m_capSize );
+
+		if( m_capOk && m_capBuf != 0 ) {
+			m_capBuf[m_capLen++] = p_dlen;
+			m_capBuf[m_capLen++] = p_code;
+		}
+		return;
+	}
+
 	if( p_addr == OM_SER_BCAST_ADDR )
 		m_isBCast = true;
 	else
 		m_isBCast = false;
 
+	// a held packet must wait for its flush, so this one is dropped
+	m_txDrop = m_txHeld;
+
+	if( m_txDrop )
+		return;
+
+	// send anything left of a previous packet, and collect this one
+	// until its last data byte has been written
+	flushPacket();
+	m_txWhole = true;
+	m_txEnd = OM_SER_PKT_PREAMBLE + p_dlen;
+
+	if( m_txProto == OM_SER_V2 )
+		m_txEnd += 1 + OM_SER_CRC_LEN;
+
+	bool slotted = ( m_txProto == OM_SER_V2 && m_txSlot != OM_SER_NO_SLOT );
+
+	if( slotted )
+		m_txEnd++;
+
     // start sequence of five nulls
 	for( uint8_t i = 0; i <= 4; i++ ) {
 		this->write((uint8_t) 0);
 	}
 
-    // start sequence termination
-	this->write((uint8_t) 255);
+    // start sequence termination, which also gives the framing version
+	if( slotted )
+		this->write((uint8_t) OM_SER_BREAK_SLOT);
+	else
+		this->write((uint8_t) ( m_txProto == OM_SER_V2 ? OM_SER_BREAK_V2 : OM_SER_BREAK_V1 ));
+
+	m_txCrc = OM_SER_CRC_INIT;
+	m_txZeros = 0;
+	m_txStuff = ( m_txProto == OM_SER_V2 );
 
     // target address
 	this->write(p_addr);
@@ -528,36 +603,269 @@ void OMMoCoBus::sendPacketHeader(uint8_t p_addr, uint8_t p_subaddr, uint8_t p_co
 
     // data length
 	this->write(p_dlen);
+
+	// sequence number
+	if( m_txProto == OM_SER_V2 )
+		this->write(m_txSeq);
+
+	// response slot
+	if( slotted )
+		this->write(m_txSlot);
 }
 
 
 
 void OMMoCoBus::sendPacketHeader(uint8_t p_addr, uint8_t p_code, uint8_t p_dlen) {
 
-	if( p_addr == OM_SER_BCAST_ADDR )
-		m_isBCast = true;
-	else
-		m_isBCast = false;
+	// sub address (defualt 0)
+	sendPacketHeader(p_addr, 0, p_code, p_dlen);
+}
 
-    // start sequence of five nulls
-	for( uint8_t i = 0; i <= 4; i++ ) {
-		this->write((uint8_t) 0);
-	}
+/** Received Packet Framing Version
 
-    // start sequence termination
-	this->write((uint8_t) 255);
+ Call after getPacket() to determine which framing the received packet used,
+ OM_SER_V1 or OM_SER_V2.
 
-	// target address
-	this->write(p_addr);
+ @return
+ The framing version of the previously received packet
+ */
 
-	// sub address (defualt 0)
-	this->write((uint8_t)0);
+uint8_t OMMoCoBus::packetProtocol() {
 
-    // command code or response code
-	this->write(p_code);
+	return( m_rxProto );
+}
 
-    // data length
-	this->write(p_dlen);
+/** Received Packet Sequence Number
+
+ Call after getPacket() to get the sequence number carried by a version 2
+ packet.  Always 0 for version 1 packets.
+
+ @return
+ The sequence number of the previously received packet
+ */
+
+uint8_t OMMoCoBus::packetSequence() {
+
+	return( m_rxProto == OM_SER_V2 ? m_rxSeq : 0 );
+}
+
+/** Received Packet was Corrupted
+
+ Call after getPacket() returns 0 to determine whether a version 2 packet was
+ read in that call, and discarded because its CRC did not match.
+
+ @return
+ True if the packet completed by the last getPacket() call failed its CRC
+ */
+
+bool OMMoCoBus::packetCorrupt() {
+
+	return( m_rxCorrupt );
+}
+
+/** Set Transmit Framing
+
+ Sets the framing used by the packets sent after this call.  For version 2
+ framing, the given sequence number is carried by each packet.
+
+ @param p_proto
+ OM_SER_V1 or OM_SER_V2
+
+ @param p_seq
+ The sequence number to send
+ */
+
+void OMMoCoBus::txFraming(uint8_t p_proto, uint8_t p_seq) {
+
+	m_txProto = p_proto;
+	m_txSeq = p_seq;
+}
+
+/** Received Packet Response Slot
+
+ Call after getPacket() to get the response slot of a slotted version 2
+ command, see OMMoCoMaster::pipelineBegin().
+
+ @return
+ The response slot of the previously received packet, or OM_SER_NO_SLOT if it
+ was not slotted
+ */
+
+uint8_t OMMoCoBus::packetSlot() {
+
+	return( m_rxSlotted ? m_rxSlot : OM_SER_NO_SLOT );
+}
+
+/** Received Packet Time
+
+ Call after getPacket() to get the time at which the last byte of the packet
+ was received.  This is the time the packet was read, less a byte time for
+ every byte received since, so it doesn't depend on how long the packet waited
+ to be read.  Response slots are timed from it.
+
+ @return
+ The micros() value at the end of the previously received packet
+ */
+
+unsigned long OMMoCoBus::packetTime() {
+
+	return( m_rxDone );
+}
+
+/** Set Transmit Response Slot
+
+ Sets the response slot carried by the version 2 packets sent after this call,
+ OM_SER_NO_SLOT for packets without a slot.
+
+ @param p_slot
+ The response slot
+ */
+
+void OMMoCoBus::txSlot(uint8_t p_slot) {
+
+	m_txSlot = p_slot;
+}
+
+/** Hold Packets
+
+ While held, a completed packet is kept in the transmit buffer instead of being
+ sent, until flushPacket() is called.  A packet which does not fit the buffer is
+ still sent in pieces as it is written.
+
+ Until a held packet has been flushed, any other packet is discarded rather than
+ sent, so that a response held for its slot can't be pushed onto the bus early
+ by whatever is sent next.
+
+ @param p_hold
+ True to hold packets, false to send them as soon as they are complete
+ */
+
+void OMMoCoBus::txHold(bool p_hold) {
+
+	m_txHold = p_hold;
+}
+
+/** Resend Last Packet
+
+ Sends the previously sent packet again, byte for byte, without it being
+ rebuilt.  This is only possible when the whole packet fit into the transmit
+ buffer.
+
+ A packet still held for flushPacket() is left waiting, and counts as sent.
+
+ @return
+ True if the packet was sent again, false if it could not be
+ */
+
+bool OMMoCoBus::resendPacket() {
+
+	if( m_txHeld )
+		return(true);
+
+	flushPacket();
+
+	if( !m_txWhole || m_txLast == 0 )
+		return(false);
+
+	m_txLen = m_txLast;
+	_sendBuffer();
+
+	return(true);
+}
+
+/** Capture Packets
+
+ Starts capturing packets: until captureEnd() is called, packets passed to
+ sendPacketHeader() and write() are not sent.  The code given to the last
+ sendPacketHeader() call is available from capturedCode(), which is how a node
+ learns the response its handler gave to a command.
+
+ If a buffer is given, each packet to the given address is appended to it as
+ its data length, its packet code and its data.  A packet to another address, or
+ one which does not fit in the remaining space, is not recorded, and
+ capturedOk() returns false until the next packet.
+
+ @param p_addr
+ The address packets must be sent to in order to be recorded
+
+ @param p_buf
+ The buffer to record packets in, or 0 to only record packet codes
+
+ @param p_size
+ The size of the buffer, in bytes
+ */
+
+void OMMoCoBus::capture(uint8_t p_addr, uint8_t* p_buf, uint8_t p_size) {
+
+	// a held packet stays held, packets captured never reach the bus
+	if( !m_txHeld )
+		flushPacket();
+
+	m_capOn = true;
+	m_capAddr = p_addr;
+	m_capBuf = p_buf;
+	m_capSize = ( p_buf != 0 ) ? p_size : 0;
+	m_capLen = 0;
+	m_capCode = 0;
+	m_capOk = true;
+}
+
+/** End Packet Capture
+
+ Stops capturing packets, see capture().
+
+ @return
+ The number of bytes recorded in the capture buffer
+ */
+
+uint8_t OMMoCoBus::captureEnd() {
+
+	m_capOn = false;
+
+	return( m_capLen );
+}
+
+/** Get Captured Packet Code
+
+ @return
+ The packet code of the last packet captured, 0 if none was
+ */
+
+uint8_t OMMoCoBus::capturedCode() {
+
+	return( m_capCode );
+}
+
+/** Last Packet was Captured
+
+ @return
+ True if the last packet captured was recorded, false if it was not sent to the
+ capture address or did not fit in the capture buffer
+ */
+
+bool OMMoCoBus::capturedOk() {
+
+	return( m_capOk );
+}
+
+/** Update CRC
+
+ Adds one byte to a CRC-16-CCITT (polynomial 0x1021, initial value
+ OM_SER_CRC_INIT), as used by version 2 framing.
+
+ @param p_crc
+ The CRC so far
+
+ @param p_dat
+ The byte to add
+
+ @return
+ The updated CRC
+ */
+
+uint16_t OMMoCoBus::crc16(uint16_t p_crc, uint8_t p_dat) {
+
+	return( _crc_xmodem_update(p_crc, p_dat) );
 }
 
 /** Received Packet was Broadcast
@@ -628,46 +936,64 @@ bool OMMoCoBus::notUs() {
 
  Writes packet data to the bus, should only ever be used after sendPacketHeader().
 
+ The byte is added to the transmit buffer, and once the last byte of the packet
+ announced by sendPacketHeader() has been written, the whole packet is sent. A
+ packet longer than the buffer is sent in buffer-sized pieces.  The CRC of a
+ version 2 packet, and the escape bytes which keep its data from containing a
+ break sequence, are added automatically.
+
  */
 
 void OMMoCoBus::write(uint8_t p_dat) {
 
+	if( m_capOn ) {
+		if( m_capOk && m_capBuf != 0 )
+			m_capBuf[m_capLen++] = p_dat;
+		return;
+	}
 
-    if (!m_softSerial) {
-
-            OMB_DEREG |= _BV(OMB_DEPFLAG);
-            m_serObj->write(p_dat);
-            OMB_DEREG &= ~_BV(OMB_DEPFLAG);
-
-        /*
-        while (!(OMB_SRSREG & _BV(OMB_SRRFLAG)));
-
-        // sets the xmit pin high if needed
-        OMB_DEREG |= _BV(OMB_DEPFLAG);
-
-        // clear tx complete flag before write, just incase serial object doesn't
-        OMB_SRSREG |= _BV(OMB_SRTXFLAG);
-
-        // push out byte
-        OMB_SRDREG = p_dat;
+	if( m_txDrop )
+		return;
 
+	_put(p_dat);
 
-        while(!(OMB_SRSREG & _BV(OMB_SRTXFLAG)) );
+	// version 2 packets end with the CRC, added after the last data byte
+	if( m_txProto == OM_SER_V2 && (unsigned int) m_txLen + OM_SER_CRC_LEN == m_txEnd ) {
+		uint16_t crc = m_txCrc;
+		_put((uint8_t) (crc >> 8));
+		_put((uint8_t) crc);
+	}
 
-        _delay_us(OM_SER_CLEAR_TM);
+	if( m_txLen >= m_txEnd ) {
+		// packet complete, a held packet waits for flushPacket()
+		if( m_txHold ) {
+			m_txEnd = 0;
+			m_txStuff = false;
+			m_txHeld = true;
+		}
+		else {
+			flushPacket();
+		}
+	}
+}
 
-        //sets the xmit pin low if needed
-        OMB_DEREG &= ~_BV(OMB_DEPFLAG);
-        */
+/** Send Pending Packet Data
 
+ Sends any packet data collected by sendPacketHeader() and write() which has not
+ yet been put on the bus.  Packets are normally sent as soon as they are complete,
+ this only needs to be called when fewer data bytes were written than announced
+ in the header.
 
-    }
+ */
 
-    else {
-        m_serObj->write(p_dat);
-    }
+void OMMoCoBus::flushPacket() {
 
+	m_txEnd = 0;
+	m_txStuff = false;
+	m_txHeld = false;
 
+	if( m_txLen > 0 )
+		_sendBuffer();
 }
 
 /** Write Data to Bus
@@ -746,35 +1072,46 @@ void OMMoCoBus::write( long p_dat ) {
 }
 
 
-uint8_t OMMoCoBus::_targetUs() {
+// Completes a received packet: checks the CRC, sets the target flags and data
+// length, and readies the parser for the next break sequence. Returns the
+// packet code, or 0 if the packet was corrupted
 
-   uint8_t thsChar = 1;
-   uint8_t ret = m_incomingPacket[0];
-   const uint8_t HEADER_LEN = 5;
-   const uint8_t ADDR_POS = 6;
-
-   // Verify that the packet header is 00 00 00 00 00 FF
-   for (uint8_t i = 0; i <= HEADER_LEN; i++)
-   {
-	   if (i < HEADER_LEN )
-	   {
-		   // If one of the first five bytes is not zero, there's a header error
-		   if (m_incomingPacket[i] != 0)
-			   return(OM_SER_ERR);
-	   }
-	   if (i == HEADER_LEN )
-	   {
-		   // If the sixth byte is not 255, there's a header error
-		   if (m_incomingPacket[i] != 255)
-			   return(OM_SER_ERR);
-	   }
-   }
-
-   // Get the address
-   addr = m_incomingPacket[ADDR_POS];
-   subaddr = m_incomingPacket[ADDR_POS+1];
+uint8_t OMMoCoBus::_endPacket() {
 
+	// the bytes which arrived after the last one of this packet tell how long
+	// ago it was received
+	m_rxDone = micros() - (unsigned long) m_serObj->available() * OM_SER_BYTE_US;
 
+	m_rxState = OM_SER_RX_SYNC;
+	m_rxPos = 0;
+
+	// version 2 packets which fail the CRC are dropped
+	if( m_rxProto == OM_SER_V2 && m_rxCrc != 0 ) {
+		m_rxCorrupt = true;
+		m_isBCast = false;
+		m_notUs = false;
+		m_bufSize = 0;
+		return(0);
+	}
+
+	// is this packet intended for us?
+	uint8_t stat = this->_targetUs();
+
+	m_isBCast = ( stat == OM_SER_IS_BCAST );
+
+	// command was for someone else, the data is still kept for
+	// the node's not-us handler
+	m_notUs = ( stat == OM_SER_NOT_US );
+
+	// check for overflow, the bytes beyond the buffer were discarded
+	m_bufSize = m_rxLen > OM_SER_BUFLEN ? OM_SER_BUFLEN : m_rxLen;
+
+	return( m_rxCode );
+}
+
+uint8_t OMMoCoBus::_targetUs() {
+
+   // the break sequence was verified, and the address read, by the parser
    if (addr == OM_SER_BCAST_ADDR)
 	   return(OM_SER_IS_BCAST);
    else if( addr != m_devAddr )
@@ -784,34 +1121,66 @@ uint8_t OMMoCoBus::_targetUs() {
 
 }
 
-uint8_t OMMoCoBus::_getNextByte(uint8_t& p_data) {
+// Adds a packet byte to the transmit buffer, followed by OM_SER_ESC when it
+// completes a run of OM_SER_ESC_RUN nulls in a version 2 packet
 
-  uint8_t ret = OM_SER_OK;
-  uint8_t* p = (uint8_t*)(void*) &p_data;
+void OMMoCoBus::_put(uint8_t p_dat) {
 
-  if( m_serObj->available() > 0 ) {
-    *p = (uint8_t) m_serObj->read();
-  }
-  else {
-    unsigned long timer = millis();
-       // wait until we have data ready
-    while( m_serObj->available() < 1 ) {
-       if( millis() - timer > OM_SER_WAIT ) {
-         // timed out waiting for complete input
-         return( OM_SER_TIMEOUT );
-       }
-    }
-    *p = (uint8_t) m_serObj->read();
-  }
+	bool esc = false;
 
+	if( m_txStuff ) {
+		if( p_dat != 0 ) {
+			m_txZeros = 0;
+		}
+		else if( ++m_txZeros == OM_SER_ESC_RUN ) {
+			// the escape byte lengthens the packet
+			m_txZeros = 0;
+			m_txEnd++;
+			esc = true;
+		}
+	}
+
+	if( m_txProto == OM_SER_V2 )
+		m_txCrc = crc16(m_txCrc, p_dat);
+
+	_putRaw(p_dat);
+
+	if( esc )
+		_putRaw(OM_SER_ESC);
+}
+
+// Adds a byte to the transmit buffer, sending the buffer if it fills before the
+// packet is complete
+
+void OMMoCoBus::_putRaw(uint8_t p_dat) {
 
-  return(ret);
+	m_txBuffer[m_txLen++] = p_dat;
+
+	if( m_txLen == OM_SER_PKT_PREAMBLE + OM_SER_BUFLEN && m_txLen < m_txEnd ) {
+		// buffer full, send this piece and continue with the rest
+		m_txEnd -= m_txLen;
+		m_txWhole = false;
+		_sendBuffer();
+	}
 }
 
-void OMMoCoBus::_flushSerial() {
- while( m_serObj->available() > 0 ) {
-    m_serObj->flush();
-  }
+// Puts the transmit buffer on the bus in one write. The driver is enabled once
+// for the whole buffer and released only when the last bit has left the UART
+
+void OMMoCoBus::_sendBuffer() {
+
+	if( !m_softSerial ) {
+		OMB_DEREG |= _BV(OMB_DEPFLAG);
+		m_serObj->write(m_txBuffer, m_txLen);
+		m_serObj->flush();
+		OMB_DEREG &= ~_BV(OMB_DEPFLAG);
+	}
+	else {
+		m_serObj->write(m_txBuffer, m_txLen);
+	}
+
+	m_txLast = m_txLen;
+	m_txLen = 0;
 }
 
 /**
@@ -28,6 +28,7 @@ OpenMoco MoCoBus Core Libraries
 #define OMMOCOBUS_H_
 
 #include <util/delay.h>
+#include <util/crc16.h>
 #include <inttypes.h>
 #include <Arduino.h>
 #include <AltSoftSerial.h>
@@ -227,20 +228,44 @@ protected:
 	void write(unsigned long p_dat);
 	void write(float p_dat);
 	void write(long p_dat);
+
+	void flushPacket();
+
+	// framing of received and sent packets
+	uint8_t packetProtocol();
+	uint8_t packetSequence();
+	bool packetCorrupt();
+	void txFraming(uint8_t p_proto, uint8_t p_seq);
+	bool resendPacket();
+
+	// response slots
+	uint8_t packetSlot();
+	unsigned long packetTime();
+	void txSlot(uint8_t p_slot);
+	void txHold(bool p_hold);
+
+	// recording packets instead of sending them
+	void capture(uint8_t p_addr, uint8_t* p_buf, uint8_t p_size);
+	uint8_t captureEnd();
+	uint8_t capturedCode();
+	bool capturedOk();
+
+	static uint16_t crc16(uint16_t p_crc, uint8_t p_dat);
 	
 
 private:
 
 	void(*f_newAddr)(uint8_t);
 
-	uint8_t _getNextByte(uint8_t&);
+	uint8_t _endPacket();
 	uint8_t _targetUs();
-	void _flushSerial();
+	void _put(uint8_t p_dat);
+	void _putRaw(uint8_t p_dat);
+	void _sendBuffer();
 
 	Stream * m_serObj;
 
 	uint8_t m_serBuffer[OM_SER_BUFLEN];
-	uint8_t m_incomingPacket[OM_SER_PKT_PREAMBLE + OM_SER_BUFLEN];
 	unsigned int m_devAddr;
 	uint8_t m_bufSize;
 
@@ -248,6 +273,49 @@ private:
 	bool m_notUs;
 	bool m_softSerial;
 
+	// receive parser state
+	uint8_t m_rxState;
+	uint8_t m_rxPos;
+	uint8_t m_rxCount;
+	uint8_t m_rxCode;
+	uint8_t m_rxLen;
+	uint8_t m_rxProto;
+	uint8_t m_rxSeq;
+	uint16_t m_rxCrc;
+	uint8_t m_rxZeros;
+	bool m_rxSlotted;
+	uint8_t m_rxSlot;
+	bool m_rxCorrupt;
+	unsigned long m_rxTime;
+	unsigned long m_rxDone;
+
+	// transmit buffer, and the buffer length at which the packet is complete
+	uint8_t m_txBuffer[OM_SER_PKT_PREAMBLE + OM_SER_BUFLEN];
+	uint8_t m_txLen;
+	unsigned int m_txEnd;
+	uint8_t m_txLast;
+	bool m_txWhole;
+	uint8_t m_txProto;
+	uint8_t m_txSeq;
+	uint16_t m_txCrc;
+	uint8_t m_txZeros;
+	bool m_txStuff;
+	uint8_t m_txSlot;
+	bool m_txHold;
+	// a completed held packet is waiting for flushPacket(), and the packet
+	// being written is discarded because of it
+	bool m_txHeld;
+	bool m_txDrop;
+
+	// packet capture
+	bool m_capOn;
+	bool m_capOk;
+	uint8_t m_capAddr;
+	uint8_t m_capCode;
+	uint8_t* m_capBuf;
+	uint8_t m_capSize;
+	uint8_t m_capLen;
+
 };
 
 
@@ -330,7 +398,8 @@ private:
  must never be repeated in the payload for a packet.  This is not of concern unless
  you are sending a sequence of raw bytes greater than 4-bytes in length.  In such cases
  one must take care to ensure that this sequence cannot be repeated - by padding
- multi-byte values, or using ascii strings for example.</i>
+ multi-byte values, or using ascii strings for example.  Version 2 framing (see
+ @ref busv2 "below") removes this restriction.</i>
 
  <b>The Target Address</b> section is a two-byte value representing the address
  of the device which the packet is destined for. At this time, only the least
@@ -404,7 +473,72 @@ private:
  option of implementing.  All broadcast commands are response-less, that is -
  nodes will act on them, or not, but no response will be received by a master.
 
-
+ @section busv2 Protocol Version 2 Framing
+
+ Version 2 of the protocol adds error detection and retry handling to the basic
+ packet.  A version 2 packet ends its break sequence with 254 (0xFE) rather than
+ 255, which version 1 devices never recognize as a packet start.  The header is
+ followed by a one-byte sequence number, and the packet ends with a CRC-16-CCITT
+ (polynomial 0x1021, initial value 0xFFFF) of every byte after the break sequence,
+ sent most significant byte first:
+
+ <table border=1 width="80%">
+ <tr>
+ <td colspan=6><b>Break Sequence</b></td>
+ <td><b>Address</b></td>
+ <td><b>Sub-address</b></td>
+ <td><b>Packet Code</b></td>
+ <td><b>Data Len</b></td>
+ <td><b>Sequence</b></td>
+ <td><b>Data</b></td>
+ <td colspan=2><b>CRC</b></td>
+ </tr>
+ <tr>
+ <td>0</td>
+ <td>0</td>
+ <td>0</td>
+ <td>0</td>
+ <td>0</td>
+ <td>254</td>
+ <td>0-255</td>
+ <td>0-255</td>
+ <td>0-255</td>
+ <td>0-255</td>
+ <td>0-255</td>
+ <td>...</td>
+ <td>hi</td>
+ <td>lo</td>
+ </tr>
+ </table>
+
+ Version 2 is opt-in: a master asks a node for its protocol version with the
+ OM_SER_COREPROTO core command, and uses version 2 framing for that node only if
+ it reports version 2 or higher.  Nodes answer each command in the framing it was
+ sent with, and broadcasts are always sent in version 1 framing.
+
+ Everything after the break sequence is byte-stuffed: after any run of four null
+ bytes the sender inserts the escape byte OM_SER_ESC, which the receiver drops.
+ A version 2 packet therefore never contains five nulls in a row, so, unlike
+ version 1 packets, its data may hold any binary values, including the break
+ sequence, at a cost of at most one byte in five.  A receiver which sees a fifth
+ null inside a packet knows bytes were lost, drops the packet, and is already
+ synchronized to the break sequence of the next one.
+
+ A command may also be slotted, for masters which send commands to several
+ nodes before collecting the responses: its break sequence ends with 253 (0xFD)
+ and its sequence number is followed by a one-byte response slot.  The node
+ executes the command, but holds its response until the master broadcasts
+ OM_BCAST_SLOT_SYNC, and then sends it once the number of slots given, each
+ OM_SER_SLOT_US microseconds long, have passed since the end of the broadcast.
+ A slot fits a response with up to OM_SER_SLOT_DATA data bytes, plus a guard
+ band of OM_SER_SLOT_GUARD byte times; a longer response needs the following
+ slots left free.
+
+ A packet failing its CRC is discarded.  Each new command from a master carries
+ a new sequence number and the response carries the same one, so a master can
+ ignore late responses to earlier commands.  If a node receives the same sequence
+ number twice in a row, the master is retrying after losing the response, and
+ the node sends its previous response again without executing the command again.
 
  */
 
@@ -56,16 +56,42 @@ enum {
 #define OM_SER_BCAST_ADDR	1
 
 
- // timeout in milliseconds
+ // timeout in milliseconds, used for devices whose response time is not yet known
 #define OM_SER_MASTER_TIMEOUT  100
 
+// bounds in milliseconds of the response timeout a master derives from the
+// measured response times of a device
+#define OM_SER_RTO_MIN	10
+#define OM_SER_RTO_MAX	200
+
+// number of devices whose response times a master tracks. This sizes arrays
+// inside OMMoCoMaster, so it is fixed rather than overridable
+#define OM_SER_RTT_NODES	8
+
+// times a master sends a version 2 command again after no response, by default
+#define OM_SER_RETRIES	2
+
+// consecutive failed commands after which a device is taken to be absent, and
+// is no longer retried
+#define OM_SER_DOWN_FAILS	3
+
 // maximum time in ms between serial bytes
 #define OM_SER_WAIT 100
-// command data buffer size in bytes
+// command data buffer size in bytes. This sizes buffers inside the library classes, so
+// it must be the same for every translation unit and isn't meant to be overridden
 #define OM_SER_BUFLEN 32
 // length of the command packet header, address, sub-address, packet code, and length
 #define OM_SER_PKT_PREAMBLE 10
 
+// number of nulls in the break sequence, before the terminating 255
+#define OM_SER_BREAK_LEN 5
+
+// receive parser states
+#define OM_SER_RX_SYNC 0
+#define OM_SER_RX_HEAD 1
+#define OM_SER_RX_DATA 2
+#define OM_SER_RX_CRC 3
+
 // return codes
 #define OM_SER_OK 1
 #define OM_SER_TIMEOUT 2
@@ -86,8 +112,74 @@ enum {
 
 #define OM_SER_CLEAR_TM 1000000.0 / OM_SER_BPS + 0.07
 
-// bus protocol core version
-#define OM_SER_VER	1
+// bus protocol core version, the highest framing version supported
+#define OM_SER_VER	2
+
+// framing versions
+#define OM_SER_V1	1
+#define OM_SER_V2	2
+
+// bytes ending the break sequence for each framing version
+#define OM_SER_BREAK_V1	255
+#define OM_SER_BREAK_V2	254
+// break sequence end of a version 2 command with a response slot
+#define OM_SER_BREAK_SLOT	253
+
+// no response slot
+#define OM_SER_NO_SLOT	255
+
+// time one byte (10 bits) takes on the bus at OM_SER_BPS, in microseconds
+#define OM_SER_BYTE_US	175
+
+// most response data bytes that fit in one response slot
+#define OM_SER_SLOT_DATA	16
+
+// byte times added to each response slot, covering the time a node takes to
+// notice its slot has come
+#define OM_SER_SLOT_GUARD	4
+
+// bytes of a slotted version 2 response which may be byte stuffed: everything
+// after the break sequence - address, subaddress, code, length, sequence
+// number, slot, OM_SER_SLOT_DATA data bytes and CRC
+#define OM_SER_SLOT_STUFFED	( OM_SER_PKT_PREAMBLE - OM_SER_BREAK_LEN - 1 + 2 + OM_SER_SLOT_DATA + OM_SER_CRC_LEN )
+
+// length of a response slot in microseconds: the break sequence, the stuffed
+// bytes with an escape after every OM_SER_ESC_RUN of them at worst, plus the
+// guard band
+#define OM_SER_SLOT_US	( ( OM_SER_BREAK_LEN + 1 + OM_SER_SLOT_STUFFED + OM_SER_SLOT_STUFFED / OM_SER_ESC_RUN + OM_SER_SLOT_GUARD ) * (unsigned long) OM_SER_BYTE_US )
+
+// node response slot states
+#define OM_SER_SLOT_NONE	0
+#define OM_SER_SLOT_HELD	1
+#define OM_SER_SLOT_SYNCED	2
+
+// most requests a pipelining master keeps outstanding
+#define OM_SER_PIPE_MAX	8
+
+// most commands a master queues to send without waiting for their responses.
+// The queue is held in OMMoCoMaster, whose layout must not depend on the sketch
+#define OM_SER_QUEUE	4
+
+// result of a queued command still waiting for its response
+#define OM_SER_PENDING	-3
+
+// most addresses in one discovery, and the length of a discovery response:
+// address, protocol version, device version and identifier
+#define OM_SER_DISC_MAX	32
+#define OM_SER_DISC_LEN	12
+
+// version 2 CRC-16-CCITT initial value, and its length in bytes
+#define OM_SER_CRC_INIT	0xFFFF
+#define OM_SER_CRC_LEN	2
+
+// version 2 byte stuffing: OM_SER_ESC is inserted after every run of
+// OM_SER_ESC_RUN nulls, which must be shorter than the break sequence
+#define OM_SER_ESC_RUN	4
+#define OM_SER_ESC	0x01
+
+// time in ms within which a node treats a repeated version 2 sequence
+// number as a retry of the same command
+#define OM_SER_DUP_WAIT	500
 
 // bus 'master' address, for responses
 #define OM_SER_MASTER	0
@@ -99,8 +191,17 @@ enum {
 #define OM_SER_COREID		2
 #define OM_SER_COREVER		3
 #define OM_SER_COREADDR		4
+#define OM_SER_COREBUNDLE	5
+#define OM_SER_CORESUB		6
+
+// packet code of a telemetry frame, whose first data byte is the address of
+// the sending node
+#define OM_SER_TELEMETRY	3
+
 
 
+// Position of the address in the packet, followed by the sub-address
+#define OM_SER_ADDR_POS  6
 
 // Position of the command code in the packet
 #define COM_POS  8
@@ -126,7 +227,13 @@ enum BroadCastType {
 		/** Set Graffik Mode Using USB Connection */
 	OM_GRAFFIK_MODE_USB = 5,
 		/** Set Graffik Mode Using BLE Connection*/
-	OM_GRAFFIK_MODE_BLE = 6
+	OM_GRAFFIK_MODE_BLE = 6,
+		/** Start of the Response Slots for Slotted Commands */
+	OM_BCAST_SLOT_SYNC = 7,
+		/** Discover the Devices in an Address Range */
+	OM_BCAST_DISCOVER = 8,
+		/** Send Telemetry Frames Due, in their Slots */
+	OM_BCAST_TELEMETRY = 9
 };
 
 
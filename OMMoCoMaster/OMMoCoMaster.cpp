@@ -20,6 +20,47 @@
 
 OMMoCoMaster::OMMoCoMaster(HardwareSerial& c_serObj) : OMMoCoBus(c_serObj) {
 
+	m_seq = 0;
+	memset(m_v2Nodes, 0, sizeof(m_v2Nodes));
+	m_cmdAddr = 0;
+
+	m_retries = OM_SER_RETRIES;
+	m_rttNext = 0;
+	memset(m_rttAddr, 0, sizeof(m_rttAddr));
+	m_bundling = false;
+	m_bundleAddr = 0;
+
+	m_piping = false;
+	m_pipeSynced = false;
+	m_pipeReject = false;
+	m_pipeCount = 0;
+	m_pipeOpen = 0;
+	m_pipeTime = 0;
+	m_pipeWindow = 0;
+	f_pipeHandler = 0;
+
+	m_queuing = false;
+	m_qSending = false;
+	m_qDelivering = false;
+	m_qSent = false;
+	m_qHead = 0;
+	m_qCount = 0;
+	m_qNext = 0;
+	m_qLast = 0;
+	m_qSeq = 0;
+	m_qTries = 0;
+	m_qTimeout = 0;
+	m_qTime = 0;
+	m_rNext = 0;
+	memset(m_rHandle, 0, sizeof(m_rHandle));
+	f_asyncHandler = 0;
+
+	f_discHandler = 0;
+
+	m_telOpen = false;
+	m_telTime = 0;
+	m_telWindow = 0;
+	f_telHandler = 0;
 }
 
 /** Broadcast a Command to All Nodes 
@@ -47,7 +88,8 @@ int OMMoCoMaster::broadcast(BroadCastType p_cmd) {
  Command code
 
  @return
- An integer with the packet code returned, or -1 for response timeout
+ An integer with the packet code returned, -1 for response timeout, or -2 if the
+ response was corrupted
  */
 
 int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd) {
@@ -70,7 +112,8 @@ int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd) {
  * Command data to send
 
  * @return
- * An integer with the packet code returned, or -1 for response timeout
+ * An integer with the packet code returned, -1 for response timeout, or -2 if the
+ * response was corrupted
  */
 int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd, uint8_t p_arg) {
 
@@ -93,7 +136,8 @@ int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd, uint8_t p_arg) {
  Command data to send
 
  @return
- An integer with the packet code returned, or -1 for response timeout
+ An integer with the packet code returned, -1 for response timeout, or -2 if the
+ response was corrupted
  */
 int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd, uint8_t p_arg, uint8_t p_arg2) {
 
@@ -118,7 +162,8 @@ int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd, uint8_t p_arg, uint8_t
  Command data to send
 
  @return
- An integer with the packet code returned, or -1 for response timeout
+ An integer with the packet code returned, -1 for response timeout, or -2 if the
+ response was corrupted
  */
 int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd, unsigned int p_arg) {
 
@@ -141,7 +186,8 @@ int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd, unsigned int p_arg) {
  Command data to send
 
  @return
- An integer with the packet code returned, or -1 for response timeout
+ An integer with the packet code returned, -1 for response timeout, or -2 if the
+ response was corrupted
  */
 int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd, unsigned long p_arg) {
 
@@ -243,7 +289,8 @@ int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd, uint8_t p_arg1, uint8_t
  Data Length
 
  @return
- An integer with the packet code returned, or -1 for response timeout
+ An integer with the packet code returned, -1 for response timeout, or -2 if the
+ response was corrupted
  */
 
 int OMMoCoMaster::command(uint8_t p_addr, uint8_t p_cmd, char* p_arg, uint8_t p_len) {
@@ -283,7 +330,8 @@ void OMMoCoMaster::address(unsigned int p_addr) {
 
 int OMMoCoMaster::responseType() {
 
-	if (bufferLen() < 1)
+	// a command which was only recorded has no response yet
+	if (deferred() || bufferLen() < 1)
 		return (-1);
 
 	char* resp = (char*) buffer();
@@ -396,30 +444,1211 @@ int OMMoCoMaster::changeAddress(uint8_t p_addr, uint8_t p_newAddr) {
 			p_newAddr) != 1)
 		return (-1);
 
+	// the negotiated framing and response times move with the device
+	uint8_t proto = protocol(p_addr);
+	protocol(p_addr, OM_SER_V1);
+	protocol(p_newAddr, proto);
+
+	uint8_t old = _rttEntry(p_newAddr, false);
+
+	if (old < OM_SER_RTT_NODES)
+		m_rttAddr[old] = 0;
+
+	old = _rttEntry(p_addr, false);
+
+	if (old < OM_SER_RTT_NODES)
+		m_rttAddr[old] = p_newAddr;
+
 	return (1);
 
 }
 
+/** Get Device Protocol Version
+
+ Returns the highest bus protocol version supported by the device at the
+ specified address.  Returns -1 on any error.
+
+ @param p_addr
+ The address of the device
+
+ @return
+ The protocol version of the device, or -1 on error.
+ */
+
+int OMMoCoMaster::getProtocol(uint8_t p_addr) {
+
+	if (command(p_addr, (uint8_t) OM_SER_BASECOM, (uint8_t) OM_SER_COREPROTO) != 1)
+		return (-1);
+
+	if (responseLen() > 1)
+		return (ntoui((uint8_t*) responseData()));
+
+	return (-1);
+}
+
+/** Negotiate Framing
+
+ Queries the protocol version of the device at the specified address, and
+ uses version 2 framing for all further commands to it if the device
+ supports it.  Version 2 framing adds a sequence number and a CRC-16 to each
+ packet, so a corrupted response is reported immediately (command() returns
+ -2) and a repeated command is recognized by the node as a retry.
+
+ Devices start out using version 1 framing, and broadcasts always use version 1
+ framing so that every device can read them.
+
+ @param p_addr
+ The address of the device
+
+ @return
+ The framing version now in use, OM_SER_V1 or OM_SER_V2, or -1 on error.
+ */
+
+int OMMoCoMaster::negotiate(uint8_t p_addr) {
+
+	// the query its self is always sent in version 1 framing
+	protocol(p_addr, OM_SER_V1);
+
+	int ver = getProtocol(p_addr);
+
+	if (ver < 0)
+		return (-1);
+
+	if (ver >= OM_SER_V2)
+		protocol(p_addr, OM_SER_V2);
+
+	return (protocol(p_addr));
+}
+
+/** Get Framing
+
+ @param p_addr
+ The address of the device
+
+ @return
+ The framing version used for commands to the device, OM_SER_V1 or OM_SER_V2
+ */
+
+uint8_t OMMoCoMaster::protocol(uint8_t p_addr) {
+
+	if (m_v2Nodes[p_addr >> 3] & (1 << (p_addr & 7)))
+		return (OM_SER_V2);
+
+	return (OM_SER_V1);
+}
+
+/** Set Framing
+
+ Sets the framing version used for commands to the device, without querying
+ the device.  See negotiate().
+
+ @param p_addr
+ The address of the device
+
+ @param p_ver
+ OM_SER_V1 or OM_SER_V2
+ */
+
+void OMMoCoMaster::protocol(uint8_t p_addr, uint8_t p_ver) {
+
+	if (p_ver == OM_SER_V2 && p_addr != OM_SER_BCAST_ADDR)
+		m_v2Nodes[p_addr >> 3] |= (1 << (p_addr & 7));
+	else
+		m_v2Nodes[p_addr >> 3] &= ~(1 << (p_addr & 7));
+}
+
+/** Begin a Command Bundle
+
+ Starts collecting commands for a single device into a bundle, which is sent
+ as one packet by bundleEnd().  The device executes the commands in order and
+ answers with a single response, so that a series of settings costs one round
+ trip on the bus instead of one per command.
+
+ Between bundleBegin() and bundleEnd(), command() does not send anything.  It
+ returns 1 if the command was added to the bundle, or -1 if it was addressed
+ to another device or the bundle is full.  Bundles are write-only: the device
+ discards the data of each command's response and reports only which commands
+ succeeded, so only commands whose response data is not needed, such as
+ settings, should be bundled.
+
+ A bundle is limited to OM_SER_BUFLEN - 1 bytes, each command taking its
+ data length plus two bytes.
+
+ For example:
+
+ @code
+ axis.bundleBegin(axis.target());
+ axis.interval(2000);
+ axis.exposure(100);
+ axis.maxShots(300);
+ int ok = axis.bundleEnd();
+ @endcode
+
+ @param p_addr
+ The address of the device
+ */
+
+void OMMoCoMaster::bundleBegin(uint8_t p_addr) {
+
+	// the commands are collected in a buffer of their own, as the receive
+	// buffer is overwritten by any response read before the bundle is sent
+	m_bundling = true;
+	m_bundleAddr = p_addr;
+	capture(p_addr, m_bundleBuf + 1, OM_SER_BUFLEN - 1);
+}
+
+/** Send a Command Bundle
+
+ Sends the commands collected since bundleBegin() to the device.  The device
+ stops at the first command which fails, leaving the commands before it
+ executed.
+
+ @param p_done
+ If not 0, receives a bit mask of the commands executed, the least significant
+ bit being the first command (only the first 32 commands are reported)
+
+ @return
+ 1 if every command was executed, 0 if a command failed, -1 for response
+ timeout, or -2 if the response was corrupted
+ */
+
+int OMMoCoMaster::bundleEnd(unsigned long* p_done) {
+
+	if (p_done != 0)
+		*p_done = 0;
+
+	if (!m_bundling)
+		return (-1);
+
+	m_bundling = false;
+
+	uint8_t len = captureEnd();
+	m_bundleBuf[0] = OM_SER_COREBUNDLE;
+
+	int ret = command(m_bundleAddr, (uint8_t) OM_SER_BASECOM, (char*) m_bundleBuf, len + 1);
+
+	// a pipelined or queued bundle is answered through its handler
+	if (ret < 0 || deferred())
+		return (ret);
+
+	if (p_done != 0 && responseLen() > 3)
+		*p_done = ntoul((uint8_t*) responseData());
+
+	return (ret == 1 ? 1 : 0);
+}
+
+/** Set Pipeline Response Handler
+
+ Sets the function called with each response to a pipelined command, see
+ pipelineBegin().  The function receives the device address, the request id
+ of the command (see requestId()), and the response code, or -1 if no response
+ arrived.  While it runs, responseType(), responseData() and responseLen()
+ describe the response.
+
+ @param p_Func
+ A function pointer matching the template void function(uint8_t, uint8_t, int)
+ */
+
+void OMMoCoMaster::pipelineHandler(void(*p_Func)(uint8_t, uint8_t, int)) {
+	f_pipeHandler = p_Func;
+}
+
+/** Begin Pipelined Commands
+
+ Starts sending commands without waiting for their responses.  Between
+ pipelineBegin() and pipelineEnd(), each command() is sent at once as a slotted
+ command, and returns 1 without waiting.  Each device executes its command as
+ it arrives, but holds its response until pipelineEnd() broadcasts the start of
+ the response slots, and then answers in the slot its command was given.  The
+ responses are delivered to the pipeline handler by pipelinePoll() or
+ pipelineWait(), matched to their commands by request id.
+
+ The bus is then busy for one turnaround and one slot (OM_SER_SLOT_US) per
+ command, rather than one full round trip per command, so that commands to
+ many devices take little more time than a command to one.
+
+ Only devices using version 2 framing (see negotiate()) can be sent pipelined
+ commands, and at most OM_SER_PIPE_MAX commands may be outstanding.  Other
+ commands return -1 without being sent.  Any pipeline still collecting
+ responses is finished first.  Each device should be sent at most one command
+ per pipeline, as a device holding a response drops any other it would send,
+ so a second command is executed but reported as unanswered.  Slots are sized
+ for responses of up to OM_SER_SLOT_DATA data bytes, so commands with longer
+ responses should not be pipelined.
+
+ For example:
+
+ @code
+ master.pipelineHandler(onResponse);
+ master.pipelineBegin();
+ for( byte i = 2; i < 8; i++ )
+    master.command(i, MY_STATUS_CMD);
+ master.pipelineEnd();
+ master.pipelineWait();
+ @endcode
+ */
+
+void OMMoCoMaster::pipelineBegin() {
+
+	pipelineWait();
+	asyncWait();
+
+	m_piping = true;
+	m_pipeSynced = false;
+	m_pipeCount = 0;
+	m_pipeOpen = 0;
+}
+
+/** End Pipelined Commands
+
+ Broadcasts the start of the response slots for the commands sent since
+ pipelineBegin(), after which responses can be collected with pipelinePoll()
+ or pipelineWait().
+
+ @return
+ The number of commands outstanding
+ */
+
+uint8_t OMMoCoMaster::pipelineEnd() {
+
+	if (!m_piping)
+		return (0);
+
+	m_piping = false;
+
+	if (m_pipeOpen == 0)
+		return (0);
+
+	broadcast(OM_BCAST_SLOT_SYNC);
+
+	// the last slot, plus the usual time for a node to answer
+	m_pipeSynced = true;
+	m_pipeTime = micros();
+	m_pipeWindow = (unsigned long) m_pipeCount * OM_SER_SLOT_US + OM_SER_MASTER_TIMEOUT * 1000UL;
+
+	return (m_pipeCount);
+}
+
+/** Collect Pipelined Responses
+
+ Reads any responses to pipelined commands already received, without waiting,
+ and passes each to the pipeline handler.  Once the last response slot has
+ passed, the commands still without a response are passed to the handler with
+ a response code of -1.
+
+ @return
+ The number of commands still waiting for a response
+ */
+
+uint8_t OMMoCoMaster::pipelinePoll() {
+
+	if (!m_pipeSynced)
+		return (0);
+
+	uint8_t code;
+
+	while (m_pipeOpen != 0 && (code = getPacket()) != 0) {
+
+		if (packetProtocol() != OM_SER_V2)
+			continue;
+
+		for (uint8_t i = 0; i < m_pipeCount; i++) {
+			if ((m_pipeOpen & (1 << i)) && m_pipeSeq[i] == packetSequence()) {
+				m_pipeOpen &= ~(1 << i);
+				if (f_pipeHandler != 0)
+					f_pipeHandler(m_pipeAddr[i], m_pipeSeq[i], code);
+				break;
+			}
+		}
+	}
+
+	if (m_pipeOpen != 0 && micros() - m_pipeTime > m_pipeWindow) {
+		for (uint8_t i = 0; i < m_pipeCount; i++) {
+			if ((m_pipeOpen & (1 << i)) && f_pipeHandler != 0)
+				f_pipeHandler(m_pipeAddr[i], m_pipeSeq[i], -1);
+		}
+		m_pipeOpen = 0;
+	}
+
+	uint8_t left = 0;
+
+	for (uint8_t i = 0; i < m_pipeCount; i++) {
+		if (m_pipeOpen & (1 << i))
+			left++;
+	}
+
+	if (left == 0)
+		m_pipeSynced = false;
+
+	return (left);
+}
+
+/** Wait for Pipelined Responses
+
+ Collects the responses to pipelined commands, as pipelinePoll() does, until
+ every command has a response or the last response slot has passed.
+ */
+
+void OMMoCoMaster::pipelineWait() {
+
+	if (m_piping)
+		pipelineEnd();
+
+	while (pipelinePoll() > 0)
+		;
+}
+
+/** Get Request Id
+
+ @return
+ The request id of the last command sent, which identifies the response to a
+ pipelined command
+ */
+
+uint8_t OMMoCoMaster::requestId() {
+	return (m_seq);
+}
+
+/** Set Discovery Handler
+
+ Sets the function called by discover() for each device found.  The function
+ receives the device address, its bus protocol version, its device type
+ version, and its 8-character identifier (not null-terminated).
+
+ @param p_Func
+ A function pointer matching the template
+ void function(uint8_t, uint8_t, unsigned int, char*)
+ */
+
+void OMMoCoMaster::discoverHandler(void(*p_Func)(uint8_t, uint8_t, unsigned int, char*)) {
+	f_discHandler = p_Func;
+}
+
+/** Discover Devices
+
+ Finds the devices at a range of addresses with a single broadcast, instead of
+ querying each address in turn and waiting out the timeout of every empty one.
+ Each device in the range answers in its own response slot, in order of
+ address, so discovery takes OM_SER_SLOT_US microseconds per address in the
+ range, however many of them are empty.
+
+ The protocol version each device reports is used as by negotiate(), and each
+ device found is passed to the discovery handler, see discoverHandler().
+
+ For example:
+
+ @code
+ unsigned long found;
+ master.discover(2, 32, &found);
+ for( byte i = 0; i < 32; i++ )
+    if( found & (1UL << i) )
+       Serial.println(i + 2);
+ @endcode
+
+ @param p_first
+ The first address of the range, by default 2
+
+ @param p_count
+ The number of addresses in the range, at most OM_SER_DISC_MAX
+
+ @param p_found
+ If given, receives the set of addresses found, one bit for each address in
+ the range starting with the least significant
+
+ @return
+ The number of devices found
+ */
+
+uint8_t OMMoCoMaster::discover(uint8_t p_first, uint8_t p_count, unsigned long* p_found) {
+
+	if (p_count > OM_SER_DISC_MAX)
+		p_count = OM_SER_DISC_MAX;
+
+	unsigned long found = 0;
+	uint8_t count = 0;
+
+	command(OM_SER_BCAST_ADDR, (uint8_t) OM_BCAST_DISCOVER, p_first, p_count);
+
+	// the last slot, plus the time for a node to notice it
+	unsigned long start = micros();
+	unsigned long window = (unsigned long) p_count * OM_SER_SLOT_US + OM_SER_RTO_MIN * 1000UL;
+
+	while (count < p_count && micros() - start < window) {
+
+		if (getPacket() != 1 || responseLen() < OM_SER_DISC_LEN)
+			continue;
+
+		uint8_t* resp = (uint8_t*) responseData();
+		uint8_t slot = resp[0] - p_first;
+
+		if (resp[0] < p_first || slot >= p_count || (found & (1UL << slot)))
+			continue;
+
+		found |= 1UL << slot;
+		count++;
+
+		protocol(resp[0], resp[1] >= OM_SER_V2 ? OM_SER_V2 : OM_SER_V1);
+
+		if (f_discHandler != 0)
+			f_discHandler(resp[0], resp[1], ntoui(resp + 2), (char*) resp + 4);
+	}
+
+	if (p_found != 0)
+		*p_found = found;
+
+	return (count);
+}
+
+/** Subscribe to Telemetry
+
+ Asks a device to send telemetry frames, rather than have its status polled
+ one value at a time.  Frames are only sent when the master broadcasts a
+ telemetry tick with telemetry(), so that they never collide with commands, and
+ each device sends its frame in its own response slot, so that they never
+ collide with each other.  A device sends a frame at most once every period,
+ skipping ticks in between, so devices may be given different rates.
+
+ Each device subscribed must be given a different slot.  A slot is
+ OM_SER_SLOT_US microseconds, long enough for a frame of OM_SER_SLOT_DATA bytes
+ including the device address, and a device refuses a subscription whose frames
+ would be longer.
+
+ @param p_addr
+ The address of the device
+
+ @param p_mask
+ The telemetry fields wanted, as defined by the device, or 0 to cancel the
+ subscription
+
+ @param p_period
+ The least time between frames, in milliseconds
+
+ @param p_slot
+ The response slot for the device's frames
+
+ @return
+ 1 if the device accepted the subscription, 0 if it refused, or a negative
+ value for a bus error as for command()
+ */
+
+int OMMoCoMaster::subscribe(uint8_t p_addr, unsigned long p_mask, unsigned int p_period, uint8_t p_slot) {
+
+	uint8_t sub[8];
+
+	sub[0] = OM_SER_CORESUB;
+	sub[1] = p_mask >> 24;
+	sub[2] = p_mask >> 16;
+	sub[3] = p_mask >> 8;
+	sub[4] = p_mask;
+	sub[5] = p_period >> 8;
+	sub[6] = p_period;
+	sub[7] = p_slot;
+
+	return (command(p_addr, (uint8_t) OM_SER_BASECOM, (char*) sub, 8));
+}
+
+/** Set Telemetry Handler
+
+ Sets the function called by telemetryPoll() for each frame received.  The
+ function receives the device address, the frame data and its length, and must
+ not send commands itself.
+
+ @param p_Func
+ A function pointer matching the template void function(uint8_t, uint8_t*, uint8_t)
+ */
+
+void OMMoCoMaster::telemetryHandler(void(*p_Func)(uint8_t, uint8_t*, uint8_t)) {
+	f_telHandler = p_Func;
+}
+
+/** Send Telemetry Tick
+
+ Broadcasts a telemetry tick, after which the frames sent in the following
+ slots can be collected with telemetryPoll() or telemetryWait(), see
+ subscribe().  Call this method at the fastest rate any device was subscribed
+ at.
+
+ No tick is sent while the bus is busy: while the frames of the last tick are
+ still being collected, while pipelined commands are waiting for their
+ responses, or while a queued command is waiting for its response.  Commands
+ sent at once while frames are being collected wait for the last slot to pass,
+ and queued commands are not sent until then.
+
+ @param p_slots
+ The number of slots to collect frames for, one more than the highest slot
+ subscribed
+
+ @return
+ true if the tick was sent, false if the bus was busy
+ */
+
+bool OMMoCoMaster::telemetry(uint8_t p_slots) {
+
+	if (m_telOpen || m_piping || m_bundling || m_pipeSynced || m_qSent)
+		return (false);
+
+	broadcast(OM_BCAST_TELEMETRY);
+
+	m_telOpen = true;
+	m_telTime = micros();
+	m_telWindow = (unsigned long) p_slots * OM_SER_SLOT_US + OM_SER_RTO_MIN * 1000UL;
+
+	return (true);
+}
+
+/** Collect Telemetry
+
+ Reads any telemetry frames already received, without waiting, and passes each
+ to the telemetry handler.
+
+ @return
+ true while the slots of the last tick have not all passed
+ */
+
+bool OMMoCoMaster::telemetryPoll() {
+
+	if (!m_telOpen)
+		return (false);
+
+	uint8_t code;
+
+	while ((code = getPacket()) != 0) {
+
+		if (code != OM_SER_TELEMETRY || bufferLen() < 1)
+			continue;
+
+		// the frame follows the address of the device
+		if (f_telHandler != 0)
+			f_telHandler(buffer()[0], (uint8_t*) responseData(), responseLen());
+	}
+
+	if (micros() - m_telTime >= m_telWindow)
+		m_telOpen = false;
+
+	return (m_telOpen);
+}
+
+/** Wait for Telemetry
+
+ Collects telemetry frames, as telemetryPoll() does, until the slots of the
+ last tick have all passed.
+ */
+
+void OMMoCoMaster::telemetryWait() {
+
+	while (telemetryPoll())
+		;
+}
+
+/** Set Asynchronous Command Handler
+
+ Sets the function called as each queued command completes, see asyncBegin().
+ The function receives the handle of the command (see asyncHandle()), the
+ device address, and the response code, or -1 if no response arrived, or -2 if
+ the response was corrupted.  While it runs, responseType(), responseData() and
+ responseLen() describe the response.
+
+ Commands sent from the handler are not queued, but sent at once and answered
+ before command() returns.  The handler must not call asyncPoll() or
+ asyncWait().
+
+ @param p_Func
+ A function pointer matching the template void function(uint8_t, uint8_t, int)
+ */
+
+void OMMoCoMaster::asyncHandler(void(*p_Func)(uint8_t, uint8_t, int)) {
+	f_asyncHandler = p_Func;
+}
+
+/** Begin Queuing Commands
+
+ Stops command() from waiting for responses.  Between asyncBegin() and
+ asyncEnd(), each command() to a device is added to a queue and returns 1 at
+ once, or -1 if the queue is full (OM_SER_QUEUE commands) or the command is too
+ long to queue.  The queued commands are sent one at a time, in order, and each
+ result is delivered to the async handler (see asyncHandler()) and kept for
+ asyncResult().
+
+ Nothing waits for the bus: the program calls asyncPoll() as often as it can,
+ for example from loop(), which reads whatever has arrived, sends the next
+ command once the previous one is answered, and retries lost commands with
+ the same timeouts and retries as command() (see retries() and
+ responseTimeout()).  A device which does not answer then costs the program
+ nothing while it keeps servicing its display, inputs and motion.
+
+ Broadcasts are never queued.  A broadcast, or a command sent after asyncEnd(),
+ is sent once every queued command has completed.
+
+ For example:
+
+ @code
+ master.asyncHandler(onDone);
+ master.asyncBegin();
+ master.command(3, MY_CMD);
+ byte handle = master.asyncHandle();
+ master.asyncEnd();
+
+ ...
+
+ void loop() {
+    master.asyncPoll();
+    updateMenu();
+ }
+ @endcode
+ */
+
+void OMMoCoMaster::asyncBegin() {
+
+	pipelineWait();
+
+	m_queuing = true;
+}
+
+/** End Queuing Commands
+
+ Makes command() wait for responses again, see asyncBegin().  Commands already
+ queued are still sent by asyncPoll(), or by the next command sent.
+ */
+
+void OMMoCoMaster::asyncEnd() {
+	m_queuing = false;
+}
+
+/** Get Queued Command Handle
+
+ @return
+ The handle of the last command queued, by which its result can be found with
+ asyncResult() or recognized by the async handler, or 0 if it was not queued
+ */
+
+uint8_t OMMoCoMaster::asyncHandle() {
+	return (m_qLast);
+}
+
+/** Service Queued Commands
+
+ Sends the next queued command if the bus is free, and reads the response to
+ the command sent, without waiting.  A command whose response is lost is sent
+ again, and a command which is finally answered, or not, is passed to the async
+ handler.  Call this method often while commands are queued.
+
+ @return
+ The number of commands not yet completed
+ */
+
+uint8_t OMMoCoMaster::asyncPoll() {
+
+	if (m_qCount == 0)
+		return (0);
+
+	// nothing is sent while telemetry frames are being collected
+	if (telemetryPoll())
+		return (m_qCount);
+
+	if (!m_qSent)
+		_asyncSend();
+
+	uint8_t addr = m_qAddr[m_qHead];
+	uint8_t entry = _rttEntry(addr, true);
+	uint8_t code = getPacket();
+
+	if (code != 0) {
+		// a version 2 response with another sequence number is a late
+		// response to an earlier command
+		if (packetProtocol() == OM_SER_V2 && packetSequence() != m_qSeq)
+			return (m_qCount);
+
+		if (m_qTries == 0)
+			_rttSample(entry, millis() - m_qTime);
+
+		m_rttFails[entry] = 0;
+		_asyncDone(code);
+		return (m_qCount);
+	}
+
+	bool corrupt = packetCorrupt();
+
+	if (!corrupt && millis() - m_qTime <= m_qTimeout)
+		return (m_qCount);
+
+	// retried as command() would
+	if (m_qTries < _rttTries(addr, entry) && resendPacket()) {
+		m_qTries++;
+		m_qTimeout = (m_qTimeout << 1) > OM_SER_RTO_MAX ? OM_SER_RTO_MAX : (m_qTimeout << 1);
+		m_qTime = millis();
+		return (m_qCount);
+	}
+
+	if (m_rttFails[entry] < 255)
+		m_rttFails[entry]++;
+
+	_asyncDone(corrupt ? -2 : -1);
+
+	return (m_qCount);
+}
+
+/** Wait for Queued Commands
+
+ Services queued commands, as asyncPoll() does, until every queued command has
+ completed.
+ */
+
+void OMMoCoMaster::asyncWait() {
+
+	while (asyncPoll() > 0)
+		;
+}
+
+/** Get Queued Command Result
+
+ @param p_handle
+ The handle of a queued command, see asyncHandle()
+
+ @return
+ OM_SER_PENDING if the command has not completed, the result command() would
+ have returned if it has, or -1 if the handle is unknown.  The results of the
+ latest OM_SER_QUEUE commands completed are kept.
+ */
+
+int OMMoCoMaster::asyncResult(uint8_t p_handle) {
+
+	if (p_handle == 0)
+		return (-1);
+
+	for (uint8_t i = 0; i < m_qCount; i++) {
+		if (m_qHandle[(m_qHead + i) % OM_SER_QUEUE] == p_handle)
+			return (OM_SER_PENDING);
+	}
+
+	for (uint8_t i = 0; i < OM_SER_QUEUE; i++) {
+		if (m_rHandle[i] == p_handle)
+			return (m_rCode[i]);
+	}
+
+	return (-1);
+}
+
+/** Set Retry Count
+
+ Sets how many times a command to a device using version 2 framing is sent
+ again when no valid response arrives in time.  The default is OM_SER_RETRIES.
+ As the device recognizes a repeated command by its sequence number, it is not
+ executed twice, but the lost response is sent again.  Each retry waits twice as
+ long as the one before, up to OM_SER_RTO_MAX milliseconds.
+
+ Commands to devices using version 1 framing are never retried, nor are
+ commands to a device which failed to answer OM_SER_DOWN_FAILS commands in a
+ row, so that a missing device costs a single timeout per command.
+
+ @param p_count
+ The number of retries, 0 to disable
+ */
+
+void OMMoCoMaster::retries(uint8_t p_count) {
+	m_retries = p_count;
+}
+
+/** Get Retry Count
+
+ @return
+ The number of times a command is sent again, see retries(uint8_t)
+ */
+
+uint8_t OMMoCoMaster::retries() {
+	return (m_retries);
+}
+
+/** Get Device Response Time
+
+ Returns the smoothed time a device takes to answer a command, as measured by
+ the master over the most recent commands.  Times are kept for the
+ OM_SER_RTT_NODES devices most recently sent a command.
+
+ @param p_addr
+ The address of the device
+
+ @return
+ The response time in milliseconds, or 0 if not known
+ */
+
+unsigned int OMMoCoMaster::rtt(uint8_t p_addr) {
+
+	uint8_t entry = _rttEntry(p_addr, false);
+
+	if (entry >= OM_SER_RTT_NODES)
+		return (0);
+
+	return (m_rttSrtt[entry] >> 3);
+}
+
+/** Get Device Response Time Variance
+
+ @param p_addr
+ The address of the device
+
+ @return
+ The mean deviation of the device's response time in milliseconds, or 0 if not
+ known
+ */
+
+unsigned int OMMoCoMaster::rttVariance(uint8_t p_addr) {
+
+	uint8_t entry = _rttEntry(p_addr, false);
+
+	if (entry >= OM_SER_RTT_NODES)
+		return (0);
+
+	return (m_rttVar[entry] >> 2);
+}
+
+/** Get Device Response Timeout
+
+ Returns how long the master waits for a response from the device before
+ retrying or giving up.  The timeout is the device's smoothed response time plus
+ four times its mean deviation, between OM_SER_RTO_MIN and OM_SER_RTO_MAX
+ milliseconds, or OM_SER_MASTER_TIMEOUT for a device which has not yet
+ answered.  A command which cannot be retried, as to a version 1 device, is
+ never given less than OM_SER_MASTER_TIMEOUT.
+
+ @param p_addr
+ The address of the device
+
+ @return
+ The response timeout in milliseconds
+ */
+
+unsigned int OMMoCoMaster::responseTimeout(uint8_t p_addr) {
+	uint8_t entry = _rttEntry(p_addr, false);
+
+	return (_rttTimeout(entry, _rttTries(p_addr, entry)));
+}
+
+/** Get Device Failures
+
+ @param p_addr
+ The address of the device
+
+ @return
+ The number of commands in a row the device has not answered, including all
+ retries
+ */
+
+uint8_t OMMoCoMaster::failures(uint8_t p_addr) {
+
+	uint8_t entry = _rttEntry(p_addr, false);
+
+	if (entry >= OM_SER_RTT_NODES)
+		return (0);
+
+	return (m_rttFails[entry]);
+}
+
+// send a packet header in the framing negotiated with the device, each
+// new command getting its own sequence number
+void OMMoCoMaster::sendPacketHeader(uint8_t p_addr, uint8_t p_subaddr, uint8_t p_code, uint8_t p_dlen) {
+
+	if (_queued(p_addr)) {
+		m_cmdAddr = p_addr;
+
+		if (m_qCount >= OM_SER_QUEUE) {
+			// the queue is full, the packet is swallowed
+			capture(p_addr, 0, 0);
+		}
+		else {
+			uint8_t tail = (m_qHead + m_qCount) % OM_SER_QUEUE;
+			m_qAddr[tail] = p_addr;
+			m_qSub[tail] = p_subaddr;
+			capture(p_addr, m_qData[tail], sizeof(m_qData[0]) > 255 ? 255 : sizeof(m_qData[0]));
+		}
+
+		OMMoCoBus::sendPacketHeader(p_addr, p_subaddr, p_code, p_dlen);
+		return;
+	}
+
+	// a command sent at once follows the queued commands, and must not talk
+	// over the responses of a pipeline
+	if (!m_piping && !m_bundling && !m_qSending && !m_qDelivering && m_qCount > 0)
+		asyncWait();
+
+	m_cmdAddr = p_addr;
+
+	if (!m_piping && !m_bundling && m_pipeSynced)
+		pipelineWait();
+
+	if (!m_bundling && m_telOpen)
+		telemetryWait();
+
+	if (m_piping && !m_bundling && p_addr != OM_SER_BCAST_ADDR) {
+		if (protocol(p_addr) != OM_SER_V2 || m_pipeCount >= OM_SER_PIPE_MAX) {
+			// cannot be pipelined, the packet is swallowed
+			m_pipeReject = true;
+			capture(p_addr, 0, 0);
+			OMMoCoBus::sendPacketHeader(p_addr, p_subaddr, p_code, p_dlen);
+			return;
+		}
+
+		m_pipeAddr[m_pipeCount] = p_addr;
+		m_pipeSeq[m_pipeCount] = m_seq + 1;
+		m_pipeOpen |= (1 << m_pipeCount);
+		txSlot(m_pipeCount++);
+	}
+
+	txFraming(protocol(p_addr), ++m_seq);
+	OMMoCoBus::sendPacketHeader(p_addr, p_subaddr, p_code, p_dlen);
+	txSlot(OM_SER_NO_SLOT);
+}
+
+void OMMoCoMaster::sendPacketHeader(uint8_t p_addr, uint8_t p_code, uint8_t p_dlen) {
+
+	sendPacketHeader(p_addr, 0, p_code, p_dlen);
+}
+
+// whether commands are being bundled, pipelined or queued, so that a command
+// returning 1 has not yet been executed
+bool OMMoCoMaster::deferred() {
+	return (m_bundling || m_piping || (m_queuing && !m_qDelivering));
+}
+
+// whether a command to the device is to be queued rather than sent
+bool OMMoCoMaster::_queued(uint8_t p_addr) {
+	return (m_queuing && !m_bundling && !m_piping && !m_qSending && !m_qDelivering && p_addr != OM_SER_BCAST_ADDR);
+}
+
+// send the first queued command
+void OMMoCoMaster::_asyncSend() {
+
+	uint8_t* pkt = m_qData[m_qHead];
+	uint8_t addr = m_qAddr[m_qHead];
+	uint8_t entry = _rttEntry(addr, true);
+
+	m_qSending = true;
+
+	sendPacketHeader(addr, m_qSub[m_qHead], pkt[1], pkt[0]);
+
+	for (uint8_t i = 0; i < pkt[0]; i++)
+		write(pkt[2 + i]);
+
+	flushPacket();
+
+	m_qSending = false;
+	m_qSent = true;
+	m_qSeq = m_seq;
+	m_qTries = 0;
+	m_qTime = millis();
+	m_qTimeout = _rttTimeout(entry, _rttTries(addr, entry));
+}
+
+// complete the first queued command, and send the next
+void OMMoCoMaster::_asyncDone(int p_code) {
+
+	uint8_t handle = m_qHandle[m_qHead];
+	uint8_t addr = m_qAddr[m_qHead];
+
+	m_qHead = (m_qHead + 1) % OM_SER_QUEUE;
+	m_qCount--;
+	m_qSent = false;
+
+	m_rHandle[m_rNext] = handle;
+	m_rCode[m_rNext] = p_code;
+	m_rNext = (m_rNext + 1) % OM_SER_QUEUE;
+
+	if (f_asyncHandler != 0) {
+		m_qDelivering = true;
+		f_asyncHandler(handle, addr, p_code);
+		m_qDelivering = false;
+	}
+
+	if (m_qCount > 0 && !m_qSent)
+		_asyncSend();
+}
+
 // get response with timeout -ignoring 
 int OMMoCoMaster::_getResponse() {
 
+		// bundled commands are only recorded
+	if (m_bundling) {
+		if (!capturedOk())
+			return (-1);
+		return (1);
+	}
+
+		// queued commands are answered through the async handler
+	if (_queued(m_cmdAddr)) {
+		uint8_t len = captureEnd();
+
+		if (len == 0 || !capturedOk()) {
+			m_qLast = 0;
+			return (-1);
+		}
+
+		uint8_t tail = (m_qHead + m_qCount) % OM_SER_QUEUE;
+
+		if (++m_qNext == 0)
+			m_qNext = 1;
+
+		m_qHandle[tail] = m_qNext;
+		m_qLast = m_qNext;
+
+		// the first command goes out at once, unless telemetry frames are
+		// being collected
+		if (++m_qCount == 1 && !m_telOpen)
+			_asyncSend();
+
+		return (1);
+	}
+
+		// pipelined commands are answered in their slots
+	if (m_piping && !isBroadcast()) {
+		if (m_pipeReject) {
+			m_pipeReject = false;
+			captureEnd();
+			return (-1);
+		}
+		flushPacket();
+		return (1);
+	}
+
+		// make sure the whole command is on the bus
+	flushPacket();
+
 		// if we sent a broadcast packet, do not look for a response
 	if( isBroadcast() == true )
 		return(1);
 	
-	unsigned long cur_tm = millis();
+	uint8_t entry = _rttEntry(m_cmdAddr, true);
+	uint8_t tries = _rttTries(m_cmdAddr, entry);
+	unsigned int tmo = _rttTimeout(entry, tries);
+
+	int ret = -1;
+
+	for (uint8_t attempt = 0; attempt <= tries; attempt++) {
+
+		if (attempt > 0) {
+			if (!resendPacket())
+				break;
+
+			// back off, in case the device is only slower than expected
+			tmo = (tmo << 1) > OM_SER_RTO_MAX ? OM_SER_RTO_MAX : (tmo << 1);
+		}
+
+		unsigned long cur_tm = millis();
+
+		// timeout if we don't get a response packet in
+		// time
+
+		while (true) {
+			uint8_t code = getPacket();
+
+			if (code != 0) {
+				// a version 2 response with another sequence number is a late
+				// response to an earlier command, keep waiting for ours
+				if (packetProtocol() != OM_SER_V2 || packetSequence() == m_seq) {
+					// the response to a retry could answer any attempt, so
+					// only the first attempt is timed
+					if (attempt == 0)
+						_rttSample(entry, millis() - cur_tm);
+
+					m_rttFails[entry] = 0;
+					return code;
+				}
+			}
+			else if (packetCorrupt()) {
+				ret = -2;
+				break;
+			}
+
+			if (millis() - cur_tm > tmo) {
+				ret = -1;
+				break;
+			}
+		}
+	}
 
-	// timeout if we don't get a response packet in
-	// time
+	if (m_rttFails[entry] < 255)
+		m_rttFails[entry]++;
 
-	uint8_t code = getPacket();
-	while (code == 0) {
-		if (millis() - cur_tm > OM_SER_MASTER_TIMEOUT)
-			return -1;
-		code = getPacket();
+	return ret;
+}
+
+// find the response time entry of a device, or assign it the least recently
+// assigned entry. returns OM_SER_RTT_NODES if the device has no entry
+uint8_t OMMoCoMaster::_rttEntry(uint8_t p_addr, bool p_add) {
+
+	for (uint8_t i = 0; i < OM_SER_RTT_NODES; i++) {
+		if (m_rttAddr[i] == p_addr && p_addr != 0)
+			return (i);
 	}
 
-	return code;
+	if (!p_add)
+		return (OM_SER_RTT_NODES);
+
+	uint8_t entry = m_rttNext;
+	m_rttNext = (m_rttNext + 1) % OM_SER_RTT_NODES;
+
+	m_rttAddr[entry] = p_addr;
+	m_rttSrtt[entry] = 0;
+	m_rttVar[entry] = 0;
+	m_rttFails[entry] = 0;
+
+	return (entry);
+}
+
+// response timeout for a response time entry, in ms. a command which will not
+// be sent again gets no less than the fixed timeout, so that one slow response
+// after a run of fast ones is not taken for a lost one
+unsigned int OMMoCoMaster::_rttTimeout(uint8_t p_entry, uint8_t p_tries) {
+
+	if (p_entry >= OM_SER_RTT_NODES || m_rttSrtt[p_entry] == 0)
+		return (OM_SER_MASTER_TIMEOUT);
+
+	unsigned int tmo = (m_rttSrtt[p_entry] >> 3) + m_rttVar[p_entry];
+
+	if (tmo < OM_SER_RTO_MIN)
+		tmo = OM_SER_RTO_MIN;
+	if (tmo > OM_SER_RTO_MAX)
+		tmo = OM_SER_RTO_MAX;
+
+	if (p_tries == 0 && tmo < OM_SER_MASTER_TIMEOUT)
+		tmo = OM_SER_MASTER_TIMEOUT;
+
+	return (tmo);
+}
+
+// times a command may be sent again: only version 2 commands can be sent again
+// safely, and a device which keeps failing to answer is probably not there at all
+uint8_t OMMoCoMaster::_rttTries(uint8_t p_addr, uint8_t p_entry) {
+
+	if (protocol(p_addr) != OM_SER_V2)
+		return (0);
+
+	if (p_entry < OM_SER_RTT_NODES && m_rttFails[p_entry] >= OM_SER_DOWN_FAILS)
+		return (0);
+
+	return (m_retries);
+}
+
+// add a measured response time to an entry, smoothing it with a gain of 1/8
+// and its mean deviation with a gain of 1/4
+void OMMoCoMaster::_rttSample(uint8_t p_entry, unsigned int p_tm) {
+
+	// a smoothed time of 0 means no time has been measured yet
+	if (p_tm == 0)
+		p_tm = 1;
+
+	if (m_rttSrtt[p_entry] == 0) {
+		m_rttSrtt[p_entry] = p_tm << 3;
+		m_rttVar[p_entry] = p_tm << 1;
+		return;
+	}
+
+	int err = (int) p_tm - (int) (m_rttSrtt[p_entry] >> 3);
+
+	m_rttSrtt[p_entry] += err;
+
+	if (err < 0)
+		err = -err;
+
+	m_rttVar[p_entry] += err - (m_rttVar[p_entry] >> 2);
 }
 
 /** 
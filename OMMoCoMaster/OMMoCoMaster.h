@@ -124,12 +124,128 @@ public:
 	char* getId(uint8_t p_addr);
 	int changeAddress(uint8_t p_addr, uint8_t p_newAddr);
 
+	int getProtocol(uint8_t p_addr);
+	int negotiate(uint8_t p_addr);
+	uint8_t protocol(uint8_t p_addr);
+	void protocol(uint8_t p_addr, uint8_t p_ver);
+
+	void bundleBegin(uint8_t p_addr);
+	int bundleEnd(unsigned long* p_done = 0);
+
+	void pipelineHandler(void(*)(uint8_t, uint8_t, int));
+	void pipelineBegin();
+	uint8_t pipelineEnd();
+	uint8_t pipelinePoll();
+	void pipelineWait();
+	uint8_t requestId();
+
+	void discoverHandler(void(*)(uint8_t, uint8_t, unsigned int, char*));
+	uint8_t discover(uint8_t p_first = 2, uint8_t p_count = OM_SER_DISC_MAX, unsigned long* p_found = 0);
+
+	int subscribe(uint8_t p_addr, unsigned long p_mask, unsigned int p_period, uint8_t p_slot);
+	void telemetryHandler(void(*)(uint8_t, uint8_t*, uint8_t));
+	bool telemetry(uint8_t p_slots);
+	bool telemetryPoll();
+	void telemetryWait();
+
+	void asyncHandler(void(*)(uint8_t, uint8_t, int));
+	void asyncBegin();
+	void asyncEnd();
+	uint8_t asyncHandle();
+	uint8_t asyncPoll();
+	void asyncWait();
+	int asyncResult(uint8_t p_handle);
+
+	void retries(uint8_t p_count);
+	uint8_t retries();
+	unsigned int rtt(uint8_t p_addr);
+	unsigned int rttVariance(uint8_t p_addr);
+	unsigned int responseTimeout(uint8_t p_addr);
+	uint8_t failures(uint8_t p_addr);
+
 private:
 
 	int _getResponse();
+	uint8_t _rttEntry(uint8_t p_addr, bool p_add);
+	unsigned int _rttTimeout(uint8_t p_entry, uint8_t p_tries);
+	uint8_t _rttTries(uint8_t p_addr, uint8_t p_entry);
+	void _rttSample(uint8_t p_entry, unsigned int p_tm);
+	bool _queued(uint8_t p_addr);
+	void _asyncSend();
+	void _asyncDone(int p_code);
+
+	// sequence number of the last command, and the devices using version 2 framing
+	uint8_t m_seq;
+	uint8_t m_v2Nodes[32];
+
+	// device the last command was sent to
+	uint8_t m_cmdAddr;
+
+	// response times of recently used devices, in ms: smoothed time x 8,
+	// mean deviation x 4, and consecutive failed commands
+	uint8_t m_retries;
+	uint8_t m_rttNext;
+	uint8_t m_rttAddr[OM_SER_RTT_NODES];
+	unsigned int m_rttSrtt[OM_SER_RTT_NODES];
+	unsigned int m_rttVar[OM_SER_RTT_NODES];
+	uint8_t m_rttFails[OM_SER_RTT_NODES];
+
+	// command bundle being collected, after the OM_SER_COREBUNDLE sub-command
+	bool m_bundling;
+	uint8_t m_bundleAddr;
+	uint8_t m_bundleBuf[OM_SER_BUFLEN];
+
+	// pipelined commands, by slot
+	bool m_piping;
+	bool m_pipeSynced;
+	bool m_pipeReject;
+	uint8_t m_pipeCount;
+	uint8_t m_pipeOpen;
+	uint8_t m_pipeAddr[OM_SER_PIPE_MAX];
+	uint8_t m_pipeSeq[OM_SER_PIPE_MAX];
+	unsigned long m_pipeTime;
+	unsigned long m_pipeWindow;
+	void(*f_pipeHandler)(uint8_t, uint8_t, int);
+
+	// queued commands, recorded as by capture(), the first being the one on
+	// the bus once sent, and the results of the latest commands answered
+	bool m_queuing;
+	bool m_qSending;
+	bool m_qDelivering;
+	bool m_qSent;
+	uint8_t m_qHead;
+	uint8_t m_qCount;
+	uint8_t m_qNext;
+	uint8_t m_qLast;
+	uint8_t m_qAddr[OM_SER_QUEUE];
+	uint8_t m_qSub[OM_SER_QUEUE];
+	uint8_t m_qHandle[OM_SER_QUEUE];
+	uint8_t m_qData[OM_SER_QUEUE][OM_SER_BUFLEN + 2];
+	uint8_t m_qSeq;
+	uint8_t m_qTries;
+	unsigned int m_qTimeout;
+	unsigned long m_qTime;
+	uint8_t m_rNext;
+	uint8_t m_rHandle[OM_SER_QUEUE];
+	int m_rCode[OM_SER_QUEUE];
+	void(*f_asyncHandler)(uint8_t, uint8_t, int);
+
+	void(*f_discHandler)(uint8_t, uint8_t, unsigned int, char*);
+
+	// the telemetry frames being collected after a tick
+	bool m_telOpen;
+	unsigned long m_telTime;
+	unsigned long m_telWindow;
+	void(*f_telHandler)(uint8_t, uint8_t*, uint8_t);
     
 protected:
 
+	// packet headers in the framing negotiated with each device
+	void sendPacketHeader(uint8_t p_addr, uint8_t p_subaddr, uint8_t p_code, uint8_t p_dlen);
+	void sendPacketHeader(uint8_t p_addr, uint8_t p_code, uint8_t p_dlen);
+
+	bool deferred();
+
 };
 
 /**
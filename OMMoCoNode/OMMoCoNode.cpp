@@ -44,6 +44,21 @@ OMMoCoNode::OMMoCoNode(Stream * c_serObj, unsigned int c_addr, unsigned int c_ve
 
 	m_id = c_id;
 
+	m_seqValid = false;
+	m_lastSeq = 0;
+	m_seqTime = 0;
+
+	m_slot = 0;
+	m_slotState = OM_SER_SLOT_NONE;
+	m_slotTime = 0;
+
+	f_telHandler = 0;
+	m_telMask = 0;
+	m_telPeriod = 0;
+	m_telSlot = 0;
+	m_telProto = OM_SER_V1;
+	m_telTime = 0;
+
 		// replace out-of-range characters with "0" (48)
 	for( uint8_t i = 0; i <= 7; i++ )
 		c_id[i] = ( c_id[i] < 32 || c_id[i] > 126 ) ? 48 : c_id[i];
@@ -261,6 +276,44 @@ void OMMoCoNode::setBCastHandler( void(*p_Func)(uint8_t, uint8_t, uint8_t*) ) {
 	f_bcastHandler = p_Func;
 }
 
+/** Set Telemetry Handler
+
+ Sets the function which writes this node's telemetry frames.  A master may
+ subscribe to telemetry from the node, giving a mask of the fields it wants, the
+ least time between frames in milliseconds, and a response slot.  When the
+ master broadcasts OM_BCAST_TELEMETRY and the period has passed, check() calls
+ the handler with the mask, a buffer and the size of the buffer, and sends the
+ frame it writes in the subscribed slot.  The meaning of the mask bits and the
+ layout of the frame are up to the device.
+
+ A frame must fit in one response slot, so the buffer holds OM_SER_SLOT_DATA - 1
+ bytes, the device address taking the first byte of the slot.  The handler must
+ never write past the buffer: it returns the number of bytes written, 0 to send
+ no frame, or the length the frame would need if the fields selected do not
+ fit.  The handler is also called when a subscription is made, and a mask whose
+ frame would not fit is refused.  Without a handler, subscriptions are refused.
+
+ @code
+ byte telemetry(unsigned long mask, byte* buf, byte size) {
+ 	byte len = 0;
+ 	if( mask & 1 ) {
+ 		if( len + 1 > size )
+ 			return size + 1;
+ 		buf[len++] = isRunning;
+ 	}
+ 	return len;
+ }
+ @endcode
+
+ @param p_Func
+ Pointer to a function taking the field mask, the frame buffer and its size,
+ and returning the frame length.
+ */
+
+void OMMoCoNode::setTelemetryHandler( uint8_t(*p_Func)(unsigned long, uint8_t*, uint8_t) ) {
+	f_telHandler = p_Func;
+}
+
 /** Set Not Us Callback Handler
 
  Sets the handler to be called from check() when a packet is received that isn't for
@@ -291,7 +344,25 @@ void OMMoCoNode::setNotUsHandler( void(*p_Func)(uint8_t, uint8_t, uint8_t, uint8
 
  check() returns 0 if no packet was available, a packet was found but not
  meant for this node, a core protocol command was received, or if an error
- occurs reading the packet.  Otherwise, it returns the packet code associated
+ occurs reading the packet.
+
+ A core protocol OM_SER_COREBUNDLE command carries several commands for this
+ node, each as its data length, packet code and data.  They are passed to the
+ command handler in order, with its responses held back, until one fails (its
+ response code is not 1).  A single R_ULONG response then reports the commands
+ executed, one bit each for the first 32 starting with the least significant,
+ and is successful only if every command was.  Bundles are write-only: the data
+ of each command's response is discarded, only its response code is kept.
+
+ Responses are sent in the framing of the command they answer.  The response to
+ a slotted command is held until the master's OM_BCAST_SLOT_SYNC broadcast, and
+ sent by a later call to check() once its slot has begun, so check() should be
+ called often while a response is held.  Until then, any other packet the node
+ would send, such as a response to another command, a packet forwarded with
+ sendPacket() or a discovery or telemetry answer, is dropped.  A version 2
+ command carrying the same sequence number as the previous one, received within
+ OM_SER_DUP_WAIT milliseconds, is a retry by the master: the previous response is
+ sent again, the command is not executed again, and 0 is returned.  Otherwise, it returns the packet code associated
  with the packet.
 
  @return
@@ -300,7 +371,8 @@ void OMMoCoNode::setNotUsHandler( void(*p_Func)(uint8_t, uint8_t, uint8_t, uint8
 
 uint8_t OMMoCoNode::check() {
 
-
+		// send a response held for its slot, if the slot has come
+	_slotResponse();
 
 	uint8_t command = this->getPacket();
 
@@ -314,11 +386,60 @@ uint8_t OMMoCoNode::check() {
         return(0);
     }
 
+		// the response slots start with the slot sync broadcast
+	if( this->isBroadcast() && command == OM_BCAST_SLOT_SYNC ) {
+		if( m_slotState == OM_SER_SLOT_HELD ) {
+			m_slotState = OM_SER_SLOT_SYNCED;
+			m_slotTime = this->packetTime();
+			_slotResponse();
+		}
+		return(0);
+	}
+
+		// a discovery is answered by the core, in a slot given by our address
+	if( this->isBroadcast() && command == OM_BCAST_DISCOVER ) {
+		_discover(this->buffer());
+		return(0);
+	}
+
+		// a telemetry tick is answered by the core, in the subscribed slot
+	if( this->isBroadcast() && command == OM_BCAST_TELEMETRY ) {
+		_telemetry();
+		return(0);
+	}
+
+		// a version 2 command repeating the sequence number of the last one
+		// is the master retrying after losing our response: send the same
+		// response again instead of executing the command twice
+	if( ! this->isBroadcast() && this->packetProtocol() == OM_SER_V2 ) {
+		if( m_seqValid && this->packetSequence() == m_lastSeq && millis() - m_seqTime < OM_SER_DUP_WAIT ) {
+			if( this->resendPacket() )
+				return(0);
+		}
+
+		m_lastSeq = this->packetSequence();
+		m_seqTime = millis();
+		m_seqValid = true;
+	}
+
+		// respond in the framing the command was sent with
+	this->txFraming(this->packetProtocol(), this->packetSequence());
+
+		// the response to a slotted command waits for its slot
+	bool slotted = ( ! this->isBroadcast() && this->packetSlot() != OM_SER_NO_SLOT );
+
+		// a response already held keeps its slot, and this one will be dropped
+	if( slotted && m_slotState == OM_SER_SLOT_NONE ) {
+		m_slot = this->packetSlot();
+		m_slotState = OM_SER_SLOT_HELD;
+		this->txHold(true);
+	}
+
 		// command OM_SER_BASECOM is reserved for core protocol commands.
 		// We handle these automatically for the node.
 	if( ! this->isBroadcast() && command == OM_SER_BASECOM ) {
 		_coreProtocol(this->buffer());
-		return(0);
+		command = 0;
 	}
 	else {
 		// we have a command code which is higher than 1,
@@ -335,10 +456,131 @@ uint8_t OMMoCoNode::check() {
 		}
 	}
 
+	if( slotted )
+		this->txHold(false);
 
 	return(command);
 }
 
+// answer a discovery for an address range including ours, in the slot given by
+// our address, with our address, protocol version, version and identifier
+
+void OMMoCoNode::_discover( uint8_t* p_buf ) {
+
+	uint8_t first = p_buf[0];
+	uint8_t me = this->address();
+
+	if( this->bufferLen() < 2 || me < first || me - first >= p_buf[1] || m_slotState != OM_SER_SLOT_NONE )
+		return;
+
+	uint8_t resp[OM_SER_DISC_LEN];
+
+	resp[0] = me;
+	resp[1] = OM_SER_VER;
+	resp[2] = m_ver >> 8;
+	resp[3] = m_ver;
+
+	for( uint8_t i = 0; i < 8; i++ )
+		resp[4 + i] = m_id[i];
+
+		// every master reads version 1 framing, and the held response
+		// replaces the last one, which can no longer be resent
+	m_seqValid = false;
+	this->txFraming(OM_SER_V1, 0);
+
+	this->txHold(true);
+	response(true, (char*) resp, OM_SER_DISC_LEN);
+	this->txHold(false);
+
+		// the discovery its self starts the slots
+	m_slot = me - first;
+	m_slotState = OM_SER_SLOT_SYNCED;
+	m_slotTime = this->packetTime();
+	_slotResponse();
+}
+
+// store a telemetry subscription: field mask, period in ms and response slot.
+// a mask of 0 cancels the subscription, and a mask whose frame would not fit
+// in a response slot is refused
+
+void OMMoCoNode::_subscribe( uint8_t* p_buf ) {
+
+	if( this->bufferLen() < 8 || f_telHandler == 0 ) {
+		response(false);
+		return;
+	}
+
+	unsigned long mask = ntoul(p_buf);
+
+	if( mask != 0 ) {
+		uint8_t frame[OM_SER_SLOT_DATA - 1];
+
+		if( f_telHandler(mask, frame, sizeof(frame)) > sizeof(frame) ) {
+			response(false);
+			return;
+		}
+	}
+
+	m_telMask = mask;
+	m_telPeriod = ntoui(p_buf + 4);
+	m_telSlot = p_buf[6];
+
+		// frames use the framing the subscription was made with
+	m_telProto = this->packetProtocol();
+
+		// the first frame is sent at the next tick
+	m_telTime = millis() - m_telPeriod;
+
+	response(true);
+}
+
+// send a telemetry frame in the subscribed slot, if the period has passed
+
+void OMMoCoNode::_telemetry() {
+
+	if( m_telMask == 0 || millis() - m_telTime < m_telPeriod || m_slotState != OM_SER_SLOT_NONE )
+		return;
+
+		// the frame and the address before it fill at most one slot
+	uint8_t frame[OM_SER_SLOT_DATA - 1];
+	uint8_t len = f_telHandler(m_telMask, frame, sizeof(frame));
+
+	if( len == 0 || len > sizeof(frame) )
+		return;
+
+	m_telTime = millis();
+
+		// the held frame replaces the last response, which can no longer
+		// be resent
+	m_seqValid = false;
+	this->txFraming(m_telProto, 0);
+
+	this->txHold(true);
+	sendPacketHeader(OM_SER_MASTER, OM_SER_TELEMETRY, len + 1);
+	this->write( (uint8_t) this->address() );
+
+	for( uint8_t i = 0; i < len; i++ )
+		this->write(frame[i]);
+
+	this->txHold(false);
+
+		// the tick its self starts the slots
+	m_slot = m_telSlot;
+	m_slotState = OM_SER_SLOT_SYNCED;
+	m_slotTime = this->packetTime();
+	_slotResponse();
+}
+
+// send a held response once its slot after the slot sync has begun
+
+void OMMoCoNode::_slotResponse() {
+
+	if( m_slotState == OM_SER_SLOT_SYNCED && micros() - m_slotTime >= (unsigned long) m_slot * OM_SER_SLOT_US ) {
+		m_slotState = OM_SER_SLOT_NONE;
+		this->flushPacket();
+	}
+}
+
 
 
 /** Get Version
@@ -380,6 +622,14 @@ void OMMoCoNode::_coreProtocol( uint8_t* p_buf ) {
 		address(p_buf[1]);
 		response(true);
 		break;
+	case OM_SER_COREBUNDLE:
+		// several commands in one packet
+		_bundle(p_buf + 1, bufferLen() - 1);
+		break;
+	case OM_SER_CORESUB:
+		// telemetry subscription
+		_subscribe(p_buf + 1);
+		break;
 	default:
 		// error
 		response(false);
@@ -388,7 +638,50 @@ void OMMoCoNode::_coreProtocol( uint8_t* p_buf ) {
 }
 
 
+// execute the commands of a bundle, in order, answering with one response.
+// Only the response codes are kept, bundles are write-only
+
+void OMMoCoNode::_bundle( uint8_t* p_buf, uint8_t p_len ) {
+
+	unsigned long done = 0;
+	uint8_t pos = 0;
+
+		// each entry is the data length, the packet code and the data
+	for( uint8_t i = 0; pos + 2 <= p_len; i++ ) {
+
+		uint8_t dlen = p_buf[pos];
+		uint8_t code = p_buf[pos + 1];
+
+		if( pos + 2 + dlen > p_len || code == OM_SER_BASECOM || f_cmdHandler == 0 )
+			break;
+
+			// the handler's response is recorded instead of sent
+		capture(OM_SER_MASTER, 0, 0);
+		f_cmdHandler(this->subaddr, code, p_buf + pos + 2);
+		captureEnd();
+
+			// stop at the first command which fails
+		if( capturedCode() != 1 )
+			break;
+
+		if( i < 32 )
+			done |= 1UL << i;
+
+		pos += 2 + dlen;
+	}
+
+		// success only if every entry was executed, the bits show which were
+	response(pos == p_len, done);
+}
+
+
 void OMMoCoNode::sendPacket(uint8_t p_addr, uint8_t p_subaddr, uint8_t p_command, uint8_t p_bufLen, uint8_t* p_buf){
+
+		// forwarded packets use version 1 framing, which every device reads, and
+		// replace the last response so it can no longer be resent
+	m_seqValid = false;
+	this->txFraming(OM_SER_V1, 0);
+
     //response(true);
     //sendPacketHeader(OM_SER_MASTER, true, 0);
     sendPacketHeader(p_addr, p_subaddr, p_command, p_bufLen);
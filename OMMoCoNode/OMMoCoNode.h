@@ -99,6 +99,7 @@ public:
 	void setHandler(void(*)(uint8_t, uint8_t, uint8_t*));
 	void setNotUsHandler(void(*)(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t*));
 	void setBCastHandler(void(*)(uint8_t, uint8_t, uint8_t*));
+	void setTelemetryHandler(uint8_t(*)(unsigned long, uint8_t*, uint8_t));
 
 	unsigned int version();
 	char* id();
@@ -108,11 +109,34 @@ private:
 	void(*f_cmdHandler)(uint8_t, uint8_t, uint8_t*);
 	void(*f_notUsHandler)(uint8_t, uint8_t, uint8_t, uint8_t, uint8_t*);
 	void(*f_bcastHandler)(uint8_t, uint8_t,uint8_t*);
+	uint8_t(*f_telHandler)(unsigned long, uint8_t*, uint8_t);
 
 	unsigned int m_ver;
 	char* m_id;
 
+		// last version 2 command answered
+	bool m_seqValid;
+	uint8_t m_lastSeq;
+	unsigned long m_seqTime;
+
+		// response held for a slot
+	uint8_t m_slot;
+	uint8_t m_slotState;
+	unsigned long m_slotTime;
+
+		// telemetry subscription
+	unsigned long m_telMask;
+	unsigned int m_telPeriod;
+	uint8_t m_telSlot;
+	uint8_t m_telProto;
+	unsigned long m_telTime;
+
 	void _coreProtocol( uint8_t* p_buf );
+	void _bundle( uint8_t* p_buf, uint8_t p_len );
+	void _slotResponse();
+	void _discover( uint8_t* p_buf );
+	void _subscribe( uint8_t* p_buf );
+	void _telemetry();
 };
 
 #endif
@@ -67,6 +67,8 @@ OMMotorFunctions::OMMotorFunctions(int p_stp=0, int p_dir=0, int p_slp=0, int p_
     //variables for the next spline
     m_nextOffCycles = 0;
     m_nextCycleErr = 0;
+    m_nextDir = OM_MOT_NO_DIR;
+    m_splineTimed = false;
 
 
     m_curPlanSpd = 0;
@@ -964,6 +966,20 @@ unsigned int OMMotorFunctions::maxStepRate() {
 	return((unsigned int)( (long) 1000000 / (long) g_curSampleRate ));
 }
 
+/** Get Cycles per Spline
+
+ Returns the number of ISR cycles in each MS_PER_SPLINE mS spline, as set by
+ maxStepRate(). Step timing compiled ahead of time must be calculated against
+ this value.
+
+ @return
+ ISR cycles per spline
+ */
+
+unsigned int OMMotorFunctions::cyclesPerSpline() {
+	return( g_cyclesPerSpline );
+}
+
 
 /** Get Steps Moved
 
@@ -1472,6 +1488,8 @@ void OMMotorFunctions::stop() {
       m_refresh = true;
       endOfMove = false;
       splineReady = false;
+      m_splineTimed = false;
+      m_nextDir = OM_MOT_NO_DIR;
       m_motCont = false;
       m_contSpd = 0.0;
 
@@ -2687,6 +2705,37 @@ void OMMotorFunctions::updateSpline(){
 
 
 
+/** Supply Spline Timing
+
+ Sets the timing of the next spline directly, instead of having updateSpline()
+ calculate it. This allows step timing compiled ahead of time (e.g. by
+ KeyFrames::compileTiming()) to be played back as a simple table walk: call
+ this whenever splineReady is false, in place of updateSpline().
+
+ Once used, the motor no longer calculates splines itself until stop() is
+ called. If no new timing has been supplied when a spline ends, the previous
+ timing is repeated.
+
+ @param p_dir
+ Direction to move during the spline, or OM_MOT_NO_DIR to keep the current direction
+
+ @param p_offCycles
+ Whole ISR cycles between steps
+
+ @param p_cycleErr
+ Fractional ISR cycles between steps, multiplied by FLOAT_TOLERANCE
+ */
+
+void OMMotorFunctions::splineTiming(uint8_t p_dir, unsigned int p_offCycles, unsigned int p_cycleErr) {
+
+    m_nextDir = p_dir;
+    m_nextOffCycles = p_offCycles < 1 ? 1 : p_offCycles;
+    m_nextCycleErr = p_cycleErr < FLOAT_TOLERANCE ? p_cycleErr : 0;
+    m_splineTimed = true;
+    endOfMove = false;
+    splineReady = true;
+}
+
 
 /** checkStep
 
@@ -2701,6 +2750,10 @@ uint8_t OMMotorFunctions::checkStep(){//uint8_t p_endOfMove){
     if (m_firstRun == true){ //run the first time the ISR is run, this populates the variables
         m_curOffCycles = m_nextOffCycles;
         m_curCycleErr = m_nextCycleErr;
+        if (m_nextDir != OM_MOT_NO_DIR){
+            dir(m_nextDir);
+            m_nextDir = OM_MOT_NO_DIR;
+        }
         m_totalCyclesTaken = 0;
         splineReady = false;
         m_firstRun = false;
@@ -2709,7 +2762,7 @@ uint8_t OMMotorFunctions::checkStep(){//uint8_t p_endOfMove){
 
 
     if( m_totalCyclesTaken >= g_cyclesPerSpline) {
-        if(splineReady == false && !continuous()){
+        if(splineReady == false && !continuous() && !m_splineTimed){
             updateSpline();
         }
 
@@ -2756,6 +2809,10 @@ uint8_t OMMotorFunctions::checkStep(){//uint8_t p_endOfMove){
         //update spline data
         m_curOffCycles = m_nextOffCycles;
         m_curCycleErr = m_nextCycleErr;
+        if (m_nextDir != OM_MOT_NO_DIR){
+            dir(m_nextDir);
+            m_nextDir = OM_MOT_NO_DIR;
+        }
         m_curSpline++;
         m_totalCyclesTaken = 0;
         splineReady = false;
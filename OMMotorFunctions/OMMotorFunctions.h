@@ -50,6 +50,8 @@ See www.openmoco.org for more information
 
 #define FLOAT_TOLERANCE  1000
 
+#define OM_MOT_NO_DIR    2
+
 #define ACCEL 0
 #define CRUISE 1
 #define DECEL 2
@@ -428,6 +430,7 @@ public:
 
 	void maxStepRate(unsigned int);
 	unsigned int maxStepRate();
+	static unsigned int cyclesPerSpline();
 
 	void maxSpeed(unsigned int);
 	unsigned int maxSpeed();
@@ -529,6 +532,7 @@ public:
     uint8_t mt_plan;
 
     void updateSpline();
+    void splineTiming(uint8_t, unsigned int, unsigned int);
     volatile uint8_t splineReady;
     uint8_t endOfMove;
 
@@ -655,6 +659,8 @@ private:
 
     unsigned long m_nextOffCycles;
     unsigned int m_nextCycleErr;
+    uint8_t m_nextDir;							// Direction for the next spline when timing is supplied with splineTiming(), or OM_MOT_NO_DIR
+    uint8_t m_splineTimed;						// Spline timing is supplied with splineTiming() rather than calculated
 
 
 
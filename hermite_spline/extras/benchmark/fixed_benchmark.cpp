@@ -0,0 +1,110 @@
+// fixed_benchmark.cpp
+
+/*
+
+Host benchmark of HermiteSplineFixed against HermiteSpline
+
+Evaluates a 4 key frame, 20 s, 12000 microstep curve at every ms, 50
+times over, with the float kernel and with the Q16 integer kernel, taking the
+reciprocal of each segment once, and reports the time per point and the
+largest deviation of the integer results from the float ones. Integer
+positions are whole microsteps, so they deviate by up to half a step. Build and run from this directory with:
+
+	g++ -O2 -I../.. fixed_benchmark.cpp ../../hermite_spline.cpp -o fixed_benchmark
+	./fixed_benchmark
+
+The host has a hardware FPU and 64 bit multiplier, so the times only
+compare the arithmetic done; on the AVR float and 64 bit arithmetic are both
+emulated and have not been timed against each other.
+
+(c) 2015 Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <math.h>
+#include <time.h>
+
+#include "hermite_spline.h"
+#include "hermite_spline_fixed.h"
+
+#define NN		4			// Key frames
+#define REPEAT	50			// Passes over the curve per timing
+#define RUNS	3
+
+static float xn[NN] = { 0, 5000, 12000, 20000 };
+static float fn[NN] = { 0, 4000, 9000, 12000 };
+static float dn[NN] = { 0, 0.9, 0.5, 0 };
+
+static int32_t xq[NN], fq[NN], dq[NN];
+
+#define N		20001
+
+static float f1[N], d1[N], s1[N];
+static int32_t f2[N], d2[N], s2[N];
+
+// Returns the time elapsed since p_start in ns per sample point
+static double nsPerPoint(clock_t p_start){
+	return (double)(clock() - p_start) * 1e9 / CLOCKS_PER_SEC / N / REPEAT;
+}
+
+int main(){
+
+	for (int i = 0; i < NN; i++){
+		xq[i] = lround(xn[i]);
+		fq[i] = lround(fn[i]);
+		dq[i] = lround(dn[i] * HermiteSplineQ::ONE);
+	}
+
+	for (int run = 0; run < RUNS; run++){
+
+		clock_t start = clock();
+		for (int rep = 0; rep < REPEAT; rep++){
+			for (int i = 0, j = 0; i < N; i++){
+				float x = i;
+				while (j < NN - 2 && xn[j + 1] < x)
+					j++;
+				HermiteSpline::cubic_value(xn[j], fn[j], dn[j], xn[j + 1], fn[j + 1], dn[j + 1], 1, &x, &f1[i], &d1[i], &s1[i]);
+			}
+		}
+		double flt = nsPerPoint(start);
+
+		// The reciprocal is only taken when a new segment is entered
+		start = clock();
+		for (int rep = 0; rep < REPEAT; rep++){
+			uint32_t r = HermiteSplineQ::reciprocal(xq[1] - xq[0]);
+			for (int i = 0, j = 0; i < N; i++){
+				while (j < NN - 2 && xq[j + 1] < i){
+					j++;
+					r = HermiteSplineQ::reciprocal(xq[j + 1] - xq[j]);
+				}
+				HermiteSplineQ::cubic_value_r(xq[j], fq[j], dq[j], xq[j + 1], fq[j + 1], dq[j + 1], r, i, &f2[i], &d2[i], &s2[i]);
+			}
+		}
+		double fix = nsPerPoint(start);
+
+		double ef = 0, ed = 0, es = 0;
+		for (int i = 0; i < N; i++){
+			ef = fmax(ef, fabs(f2[i] - f1[i]));
+			ed = fmax(ed, fabs((double)d2[i] / HermiteSplineQ::ONE - d1[i]));
+			es = fmax(es, fabs((double)s2[i] / HermiteSplineQ::ONE - s1[i]));
+		}
+
+		printf("float %.2f ns/pt  Q%d %.2f ns/pt  max deviation f %g d %g s %g\n", flt, HS_FIXED_Q, fix, ef, ed, es);
+	}
+
+	return 0;
+}
@@ -0,0 +1,91 @@
+// sorted_benchmark.cpp
+
+/*
+
+Host benchmark of HermiteSpline::cubic_spline_value_sorted()
+
+Evaluates 1M ascending sample points over a 64 segment spline, once
+with the per-sample cubic_spline_value() and once with the sorted batch
+evaluator, and reports the time per point and the largest difference
+between the two (summed over f, d and s). Build and run from this
+directory with:
+
+	g++ -O2 -I../.. sorted_benchmark.cpp ../../hermite_spline.cpp -o sorted_benchmark
+	./sorted_benchmark
+
+Add -O3 -march=native to see the vectorized batch loop.
+
+(c) 2015 Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+
+#include "hermite_spline.h"
+
+#define NN		64			// Data points
+#define N		1000000		// Sample points
+#define RUNS	3
+
+static float xn[NN], fn[NN], dn[NN];
+static float x[N], f1[N], d1[N], s1[N], f2[N], d2[N], s2[N];
+
+// Returns the time elapsed since p_start in ns per sample point
+static double nsPerPoint(clock_t p_start){
+	return (double)(clock() - p_start) * 1e9 / CLOCKS_PER_SEC / N;
+}
+
+int main(){
+
+	float acc = 0;
+
+	// Irregular key frames, with samples running slightly past either end
+	srand(1);
+	for (int i = 0; i < NN; i++){
+		acc += 10 + rand() % 100;
+		xn[i] = acc;
+		fn[i] = rand() % 1000;
+		dn[i] = (rand() % 100 - 50) / 10.0;
+	}
+	for (int i = 0; i < N; i++)
+		x[i] = xn[0] - 5 + (xn[NN - 1] + 10 - xn[0]) * i / (float)N;
+
+	for (int run = 0; run < RUNS; run++){
+
+		clock_t start = clock();
+		HermiteSpline::cubic_spline_value(NN, xn, fn, dn, N, x, f1, d1, s1);
+		double scalar = nsPerPoint(start);
+
+		int left = 0;
+		start = clock();
+		HermiteSpline::cubic_spline_value_sorted(NN, xn, fn, dn, N, x, f2, d2, s2, &left);
+		double batch = nsPerPoint(start);
+
+		double diff = 0;
+		for (int i = 0; i < N; i++){
+			double e = fabs(f1[i] - f2[i]) + fabs(d1[i] - d2[i]) + fabs(s1[i] - s2[i]);
+			if (e > diff)
+				diff = e;
+		}
+
+		printf("scalar %.2f ns/pt  batch %.2f ns/pt  max difference %g\n", scalar, batch, diff);
+	}
+
+	return 0;
+}
@@ -38,7 +38,7 @@ Hermite Cubic Spline Evaluation Functions
 
 /******************************************************************************/
 
-void HermiteSpline::r8vec_bracket3(int n, float t[], float tval, int *left)
+bool HermiteSpline::r8vec_bracket3(int n, float t[], float tval, int *left)
 
 /******************************************************************************/
 /*
@@ -63,7 +63,9 @@ to the (extreme) abscissa must be found so that extrapolation
 can be carried out.
 
 This version of the function has been revised so that the value of
-LEFT that is returned uses the 0-based indexing natural to C++.
+LEFT that is returned uses the 0-based indexing natural to C++, and so
+that invalid input is reported through the return value rather than
+terminating the program.
 
 Licensing:
 
@@ -93,6 +95,9 @@ or right.  After that, a binary search is used.
 On output, LEFT is set so that the interval [ T[LEFT], T[LEFT+1] ]
 is the closest to TVAL; it either contains TVAL, or else TVAL
 lies outside the interval [ T[0], T[N-1] ].
+
+Output, bool R8VEC_BRACKET3, false if N is less than 2, in which case
+LEFT is unchanged.
 */
 {
 	int high;
@@ -103,10 +108,7 @@ lies outside the interval [ T[0], T[N-1] ].
 	*/
 	if (n < 2)
 	{
-		fprintf(stderr, "\n");
-		fprintf(stderr, "R8VEC_BRACKET3 - Fatal error\n");
-		fprintf(stderr, "  N must be at least 2.\n");
-		exit(1);
+		return false;
 	}
 	/*
 	If *LEFT is not between 0 and N-2, set it to the middle value.
@@ -123,22 +125,22 @@ lies outside the interval [ T[0], T[N-1] ].
 	{
 		if (*left == 0)
 		{
-			return;
+			return true;
 		}
 		else if (*left == 1)
 		{
 			*left = 0;
-			return;
+			return true;
 		}
 		else if (t[*left - 1] <= tval)
 		{
 			*left = *left - 1;
-			return;
+			return true;
 		}
 		else if (tval <= t[1])
 		{
 			*left = 0;
-			return;
+			return true;
 		}
 		/*
 		...Binary search for TVAL in (T[I],T[I+1]), for I = 1 to *LEFT-2.
@@ -151,7 +153,7 @@ lies outside the interval [ T[0], T[N-1] ].
 			if (low == high)
 			{
 				*left = low;
-				return;
+				return true;
 			}
 
 			mid = (low + high + 1) / 2;
@@ -174,22 +176,22 @@ lies outside the interval [ T[0], T[N-1] ].
 	{
 		if (*left == n - 2)
 		{
-			return;
+			return true;
 		}
 		else if (*left == n - 3)
 		{
 			*left = *left + 1;
-			return;
+			return true;
 		}
 		else if (tval <= t[*left + 2])
 		{
 			*left = *left + 1;
-			return;
+			return true;
 		}
 		else if (t[n - 2] <= tval)
 		{
 			*left = n - 2;
-			return;
+			return true;
 		}
 		/*
 		...Binary search for TVAL in (T[I],T[I+1]) for intervals I = *LEFT+2 to N-3.
@@ -203,7 +205,7 @@ lies outside the interval [ T[0], T[N-1] ].
 			if (low == high)
 			{
 				*left = low;
-				return;
+				return true;
 			}
 
 			mid = (low + high + 1) / 2;
@@ -226,7 +228,7 @@ lies outside the interval [ T[0], T[N-1] ].
 	{
 	}
 
-	return;
+	return true;
 }
 
 /******************************************************************************/
@@ -309,7 +311,77 @@ void HermiteSpline::cubic_value(float x1, float f1, float d1, float x2,
 
 /******************************************************************************/
 
-void HermiteSpline::cubic_spline_value(int nn, float xn[], float fn[],
+void HermiteSpline::cubic_bounds(float x1, float f1, float d1, float x2,
+	float f2, float d2, float* vmax, float* amax)
+
+/******************************************************************************/
+/*
+Purpose:
+
+CUBIC_BOUNDS returns the largest absolute first and second derivatives of a
+Hermite cubic polynomial over its interval.
+
+Discussion:
+
+The first derivative is a quadratic, so its extreme values lie at the ends
+of the interval or at the vertex of the parabola, if that falls inside. The
+second derivative is linear, so its extremes lie at the ends.
+
+Parameters:
+
+Input, float X1, F1, D1, the left endpoint, function value
+and derivative.
+
+Input, float X2, F2, D2, the right endpoint, function value
+and derivative.
+
+Output, float *VMAX, *AMAX, the largest absolute first and second
+derivatives on [X1, X2].
+*/
+{
+	float c2;
+	float c3;
+	float df;
+	float h;
+	float t;
+	float v;
+
+	h = x2 - x1;
+	df = (f2 - f1) / h;
+
+	c2 = -(2.0 * d1 - 3.0 * df + d2) / h;
+	c3 = (d1 - 2.0 * df + d2) / h / h;
+
+	*vmax = fabs(d1);
+	if (*vmax < fabs(d2))
+	{
+		*vmax = fabs(d2);
+	}
+
+	if (c3 != 0.0)
+	{
+		t = -c2 / (3.0 * c3);
+		if (0.0 < t && t < h)
+		{
+			v = fabs(d1 - c2 * c2 / (3.0 * c3));
+			if (*vmax < v)
+			{
+				*vmax = v;
+			}
+		}
+	}
+
+	*amax = fabs(2.0 * c2);
+	if (*amax < fabs(2.0 * c2 + 6.0 * c3 * h))
+	{
+		*amax = fabs(2.0 * c2 + 6.0 * c3 * h);
+	}
+	return;
+}
+
+/******************************************************************************/
+
+bool HermiteSpline::cubic_spline_value(int nn, float xn[], float fn[],
 	float dn[], int n, float x[], float f[], float d[], float s[])
 
 	/******************************************************************************/
@@ -361,6 +433,9 @@ void HermiteSpline::cubic_spline_value(int nn, float xn[], float fn[],
 
 	Output, float T[N], the third derivative value at the
 	sample points.
+
+	Output, bool HERMITE_CUBIC_SPLINE_VALUE, false if NN is less than 2,
+	in which case no values are computed.
 	*/
 {
 	int i;
@@ -370,10 +445,317 @@ void HermiteSpline::cubic_spline_value(int nn, float xn[], float fn[],
 
 	for (i = 0; i < n; i++)
 	{
-		r8vec_bracket3(nn, xn, x[i], &left);
+		if (!r8vec_bracket3(nn, xn, x[i], &left))
+		{
+			return false;
+		}
 
 		cubic_value(xn[left], fn[left], dn[left], xn[left + 1],
 			fn[left + 1], dn[left + 1], 1, x + i, f + i, d + i, s + i);
 	}
-	return;
+	return true;
+}
+
+
+
+#if !defined(__AVR__)
+
+/******************************************************************************/
+
+bool HermiteSpline::cubic_spline_value_sorted(int nn, const float xn[],
+	const float fn[], const float dn[], int n, const float x[], float f[],
+	float d[], float s[], int *left)
+
+	/******************************************************************************/
+	/*
+	Purpose:
+
+	HERMITE_CUBIC_SPLINE_VALUE_SORTED evaluates a Hermite cubic spline at many
+	sample points sorted into ascending order.
+
+	Discussion:
+
+	This version is only built for host targets, such as the control app
+	rendering previews of a curve. Instead of bracketing and evaluating each
+	sample separately, it walks a segment cursor forward through the data,
+	works out the polynomial coefficients of each segment once, and evaluates
+	the run of samples falling in that segment with a branch-free Horner loop
+	that the compiler can vectorize. Samples before XN[0] or after XN[NN-1]
+	are extrapolated from the first or last segment, as in
+	HERMITE_CUBIC_SPLINE_VALUE.
+
+	Parameters:
+
+	Input, int NN, the number of data points.
+
+	Input, float XN[NN], the coordinates of the data points.
+	The entries in XN must be in strictly ascending order.
+
+	Input, float FN[NN], the function values.
+
+	Input, float DN[NN], the derivative values.
+
+	Input, int N, the number of sample points.
+
+	Input, float X[N], the coordinates of the sample points, in
+	ascending order.
+
+	Output, float F[N], D[N], S[N], the function value and first two
+	derivatives at the sample points.
+
+	Input/output, int *LEFT, the segment cursor. On input, the segment
+	in which to start searching, e.g. 0, or the value left by a previous
+	call when a long sample array is evaluated in chunks. On output, the
+	segment containing the last sample.
+
+	Output, bool HERMITE_CUBIC_SPLINE_VALUE_SORTED, false if NN is less
+	than 2, in which case no values are computed.
+	*/
+{
+	int i;
+	int j;
+	int k;
+	float c1;
+	float c2;
+	float c3;
+	float df;
+	float h;
+	float t;
+	float x1;
+	float x2;
+	float f1;
+
+	if (nn < 2)
+	{
+		return false;
+	}
+
+	if (*left < 0 || nn - 2 < *left)
+	{
+		*left = 0;
+	}
+
+	i = 0;
+
+	while (i < n)
+	{
+		/*
+		Move the cursor forward to the segment containing X[I].
+		*/
+		if (x[i] < xn[*left])
+		{
+			r8vec_bracket3(nn, (float*)xn, x[i], left);
+		}
+		while (*left < nn - 2 && xn[*left + 1] < x[i])
+		{
+			*left = *left + 1;
+		}
+		/*
+		Find the run of samples in this segment.
+		*/
+		j = i + 1;
+		if (*left == nn - 2)
+		{
+			j = n;
+		}
+		else
+		{
+			while (j < n && x[j] <= xn[*left + 1])
+			{
+				j++;
+			}
+		}
+		/*
+		Coefficients of the segment, shared by the whole run.
+		*/
+		x1 = xn[*left];
+		x2 = xn[*left + 1];
+		f1 = fn[*left];
+		h = x2 - x1;
+		df = (fn[*left + 1] - f1) / h;
+		c1 = dn[*left];
+		c2 = -(2.0f * c1 - 3.0f * df + dn[*left + 1]) / h;
+		c3 = (c1 - 2.0f * df + dn[*left + 1]) / h / h;
+
+		for (k = i; k < j; k++)
+		{
+			t = x[k] - x1;
+			f[k] = f1 + t * (c1 + t * (c2 + t * c3));
+			d[k] = c1 + t * (2.0f * c2 + t * 3.0f * c3);
+			s[k] = 2.0f * c2 + t * 6.0f * c3;
+		}
+
+		i = j;
+	}
+	return true;
+}
+
+#endif
+
+/******************************************************************************/
+
+float HermiteSpline::monotone_slope(float h0, float del0, float h1, float del1)
+
+/******************************************************************************/
+/*
+Purpose:
+
+MONOTONE_SLOPE returns the derivative at an interior data point that keeps
+a Hermite cubic spline monotone on both neighbouring intervals.
+
+Discussion:
+
+The slope is zero at local extrema (where the secants change sign), and
+otherwise the weighted harmonic mean of the two secants, which always
+satisfies the Fritsch-Carlson monotonicity conditions.
+
+Reference:
+
+Fred Fritsch, Ralph Carlson,
+Monotone Piecewise Cubic Interpolation,
+SIAM Journal on Numerical Analysis,
+Volume 17, Number 2, April 1980, pages 238-246.
+
+Parameters:
+
+Input, float H0, DEL0, the width and secant slope of the left interval.
+
+Input, float H1, DEL1, the width and secant slope of the right interval.
+*/
+{
+	float w1;
+	float w2;
+
+	if (del0 * del1 <= 0.0)
+	{
+		return 0.0;
+	}
+
+	w1 = 2.0 * h1 + h0;
+	w2 = h1 + 2.0 * h0;
+
+	return (w1 + w2) / (w1 / del0 + w2 / del1);
+}
+
+/******************************************************************************/
+
+float HermiteSpline::catmull_rom_slope(float h0, float del0, float h1, float del1)
+
+/******************************************************************************/
+/*
+Purpose:
+
+CATMULL_ROM_SLOPE returns the derivative at an interior data point for a
+Catmull-Rom spline, that is the slope of the chord between its neighbours.
+
+Parameters:
+
+Input, float H0, DEL0, the width and secant slope of the left interval.
+
+Input, float H1, DEL1, the width and secant slope of the right interval.
+*/
+{
+	return (h0 * del0 + h1 * del1) / (h0 + h1);
+}
+
+/******************************************************************************/
+
+void HermiteSpline::monotone_slopes(int nn, float xn[], float fn[], float dn[])
+
+/******************************************************************************/
+/*
+Purpose:
+
+MONOTONE_SLOPES computes derivatives for all data points in one pass so
+that the resulting Hermite cubic spline never overshoots the data.
+
+Discussion:
+
+End points use the slope of their only neighbouring interval.
+
+Parameters:
+
+Input, int NN, the number of data points, at least 2.
+
+Input, float XN[NN], FN[NN], the data points, XN strictly ascending.
+
+Output, float DN[NN], the derivative values.
+*/
+{
+	int i;
+	float h0;
+	float h1;
+	float del0;
+	float del1;
+
+	if (nn < 2)
+	{
+		return;
+	}
+
+	h1 = xn[1] - xn[0];
+	del1 = (fn[1] - fn[0]) / h1;
+	dn[0] = del1;
+
+	for (i = 1; i < nn - 1; i++)
+	{
+		h0 = h1;
+		del0 = del1;
+		h1 = xn[i + 1] - xn[i];
+		del1 = (fn[i + 1] - fn[i]) / h1;
+		dn[i] = monotone_slope(h0, del0, h1, del1);
+	}
+
+	dn[nn - 1] = del1;
+}
+
+/******************************************************************************/
+
+void HermiteSpline::catmull_rom_slopes(int nn, float xn[], float fn[], float dn[])
+
+/******************************************************************************/
+/*
+Purpose:
+
+CATMULL_ROM_SLOPES computes Catmull-Rom derivatives for all data points
+in one pass.
+
+Discussion:
+
+End points use the slope of their only neighbouring interval.
+
+Parameters:
+
+Input, int NN, the number of data points, at least 2.
+
+Input, float XN[NN], FN[NN], the data points, XN strictly ascending.
+
+Output, float DN[NN], the derivative values.
+*/
+{
+	int i;
+	float h0;
+	float h1;
+	float del0;
+	float del1;
+
+	if (nn < 2)
+	{
+		return;
+	}
+
+	h1 = xn[1] - xn[0];
+	del1 = (fn[1] - fn[0]) / h1;
+	dn[0] = del1;
+
+	for (i = 1; i < nn - 1; i++)
+	{
+		h0 = h1;
+		del0 = del1;
+		h1 = xn[i + 1] - xn[i];
+		del1 = (fn[i + 1] - fn[i]) / h1;
+		dn[i] = catmull_rom_slope(h0, del0, h1, del1);
+	}
+
+	dn[nn - 1] = del1;
 }
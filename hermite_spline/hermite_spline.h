@@ -7,19 +7,34 @@
 
 #if defined(ARDUINO) && ARDUINO >= 100
 	#include "Arduino.h"
-#else
+#elif defined(ARDUINO)
 	#include "WProgram.h"
+#else
+	// Host builds, e.g. the control app or the benchmarks in extras
+	#include <inttypes.h>
+	#include <math.h>
 #endif
 
 class HermiteSpline
 {
  public:
-	 static void cubic_spline_value(int nn, float xn[], float fn[],
+	 static bool cubic_spline_value(int nn, float xn[], float fn[],
 		 float dn[], int n, float x[], float f[], float d[], float s[]);
 	 static void cubic_value(float x1, float f1, float d1, float x2,
 		 float f2, float d2, int n, float x[], float f[], float d[],
 		 float s[]);
-	 static void r8vec_bracket3(int n, float t[], float tval, int *left);
+	 static void cubic_bounds(float x1, float f1, float d1, float x2,
+		 float f2, float d2, float* vmax, float* amax);
+	 static bool r8vec_bracket3(int n, float t[], float tval, int *left);
+#if !defined(__AVR__)
+	 static bool cubic_spline_value_sorted(int nn, const float xn[],
+		 const float fn[], const float dn[], int n, const float x[], float f[],
+		 float d[], float s[], int *left);
+#endif
+	 static float monotone_slope(float h0, float del0, float h1, float del1);
+	 static float catmull_rom_slope(float h0, float del0, float h1, float del1);
+	 static void monotone_slopes(int nn, float xn[], float fn[], float dn[]);
+	 static void catmull_rom_slopes(int nn, float xn[], float fn[], float dn[]);
  private:
 	 
 	
@@ -0,0 +1,192 @@
+// hermite_spline_fixed.h
+
+/*
+
+Fixed-point Hermite cubic spline evaluation
+
+Integer counterpart of HermiteSpline. Abscissas are whole milliseconds,
+positions are whole microsteps, and derivatives are Q-format values (Q
+fractional bits) in microsteps per millisecond, or microsteps per millisecond
+squared for second derivatives. No float arithmetic is used, each result is
+rounded once to the nearest unit, and errors are returned rather than
+terminating.
+
+Divisions by the interval length are replaced by multiplies with its
+reciprocal. cubic_value() works the reciprocal out on every call, while
+callers evaluating many points of one segment can take it once with
+reciprocal() and use cubic_value_r(), or pass the position within the
+segment directly to cubic_value_u().
+
+Intermediate products are 64 bit, which avr-gcc emulates in software just as
+it does float arithmetic, so the kernel is not known to be faster than
+HermiteSpline on the AVR; it has only been timed on the host, see
+extras/benchmark/fixed_benchmark.cpp.
+
+The fraction width is a template parameter so that each build can choose
+its own precision, HS_FIXED_Q selects the width of the HermiteSplineQ
+typedef (16 by default).
+
+(c) 2015 Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef _HERMITE_SPLINE_FIXED_h
+#define _HERMITE_SPLINE_FIXED_h
+
+#include <inttypes.h>
+
+// Return codes
+#define HS_OK			0	// Values were computed
+#define HS_ERR_COUNT	1	// Fewer than two data points
+#define HS_ERR_ORDER	2	// Abscissas are not strictly ascending
+
+#ifndef HS_FIXED_Q
+	#define HS_FIXED_Q	16
+#endif
+
+template <uint8_t Q>
+class HermiteSplineFixed
+{
+ public:
+
+	 static const int32_t ONE = (int32_t)1 << Q;
+
+	 // Finds the interval [ t[*left], t[*left+1] ] containing or nearest tval, using *left as a hint
+	 static uint8_t bracket(int n, const int32_t t[], int32_t tval, int* left){
+
+		 if (n < 2)
+			 return HS_ERR_COUNT;
+
+		 if (*left < 0 || *left > n - 2)
+			 *left = (n - 1) / 2;
+
+		 // Most calls move forward by at most one interval
+		 if (t[*left] <= tval && tval <= t[*left + 1])
+			 return HS_OK;
+		 if (*left < n - 2 && t[*left + 1] <= tval && tval <= t[*left + 2]){
+			 (*left)++;
+			 return HS_OK;
+		 }
+
+		 int low = 0;
+		 int high = n - 2;
+
+		 while (low < high){
+			 int mid = (low + high + 1) / 2;
+			 if (t[mid] <= tval)
+				 low = mid;
+			 else
+				 high = mid - 1;
+		 }
+
+		 *left = low;
+		 return HS_OK;
+	 }
+
+	 // Returns the reciprocal of an interval length for cubic_value_r(), scaled by 2^32. Compute it once per segment, h must be positive
+	 static uint32_t reciprocal(int32_t h){
+		 return 0xFFFFFFFFUL / (uint32_t)h;
+	 }
+
+	 // Returns a / h given r = reciprocal(h), using only multiplies
+	 static int64_t mul_q32(int64_t a, uint32_t r){
+
+		 uint64_t m = a < 0 ? -(uint64_t)a : (uint64_t)a;
+
+		 // Split a in halves so that neither partial product overflows
+		 uint64_t q = (m >> 32) * r + (((m & 0xFFFFFFFFUL) * r) >> 32);
+
+		 return a < 0 ? -(int64_t)q : (int64_t)q;
+	 }
+
+	 // Returns a >> p rounded to the nearest integer rather than down
+	 static int64_t shift_round(int64_t a, uint8_t p){
+		 return (a + ((int64_t)1 << (p - 1))) >> p;
+	 }
+
+	 // Evaluates the Hermite cubic through (x1, f1, d1) and (x2, f2, d2) at x
+	 static uint8_t cubic_value(int32_t x1, int32_t f1, int32_t d1, int32_t x2,
+		 int32_t f2, int32_t d2, int32_t x, int32_t* f, int32_t* d, int32_t* s){
+
+		 if (x2 <= x1)
+			 return HS_ERR_ORDER;
+
+		 return cubic_value_r(x1, f1, d1, x2, f2, d2, reciprocal(x2 - x1), x, f, d, s);
+	 }
+
+	 // Evaluates the Hermite cubic through (x1, f1, d1) and (x2, f2, d2) at x, r is reciprocal(x2 - x1)
+	 static uint8_t cubic_value_r(int32_t x1, int32_t f1, int32_t d1, int32_t x2,
+		 int32_t f2, int32_t d2, uint32_t r, int32_t x, int32_t* f, int32_t* d, int32_t* s){
+
+		 int64_t h = (int64_t)x2 - x1;
+
+		 if (h <= 0)
+			 return HS_ERR_ORDER;
+
+		 // Normalised position within the interval, rounded to the nearest 2^-Q
+		 int64_t u = mul_q32(((int64_t)(x - x1) << Q) + (h >> 1), r);
+
+		 return cubic_value_u(f1, d1, f2, d2, (int32_t)h, r, (int32_t)u, f, d, s);
+	 }
+
+	 // Evaluates the Hermite cubic through f1, d1 and f2, d2 at the Q-format position u (0 to ONE) of an interval
+	 // h ms long, r is reciprocal(h)
+	 static uint8_t cubic_value_u(int32_t f1, int32_t d1, int32_t f2, int32_t d2, int32_t h,
+		 uint32_t r, int32_t u, int32_t* f, int32_t* d, int32_t* s){
+
+		 if (h <= 0)
+			 return HS_ERR_ORDER;
+
+		 // Powers of the position
+		 int64_t u1 = u;
+		 int64_t u2 = shift_round(u1 * u1, Q);
+		 int64_t u3 = shift_round(u2 * u1, Q);
+		 int64_t df = (int64_t)f2 - f1;
+
+		 // Basis functions weighting the position change and each derivative
+		 int64_t b01 = 3 * u2 - 2 * u3;
+		 int64_t b10 = u3 - 2 * u2 + u1;
+		 int64_t b11 = u3 - u2;
+
+		 // Both terms are kept at 2Q fractional bits so the position is only rounded once
+		 *f = f1 + (int32_t)shift_round(((df * b01) << Q) + ((int64_t)d1 * b10 + (int64_t)d2 * b11) * h, 2 * Q);
+
+		 *d = (int32_t)(mul_q32(df * 6 * (u1 - u2), r)
+			 + shift_round((int64_t)d1 * (3 * u2 - 4 * u1 + ONE) + (int64_t)d2 * (3 * u2 - 2 * u1), Q));
+
+		 *s = (int32_t)(mul_q32(mul_q32(df * (6 * (int64_t)ONE - 12 * u1), r), r)
+			 + mul_q32(shift_round((int64_t)d1 * (6 * u1 - 4 * (int64_t)ONE) + (int64_t)d2 * (6 * u1 - 2 * (int64_t)ONE), Q), r));
+
+		 return HS_OK;
+	 }
+
+	 // Evaluates the Hermite cubic spline through nn data points at x, *left is the interval hint
+	 static uint8_t cubic_spline_value(int nn, const int32_t xn[], const int32_t fn[],
+		 const int32_t dn[], int32_t x, int32_t* f, int32_t* d, int32_t* s, int* left){
+
+		 uint8_t ret = bracket(nn, xn, x, left);
+
+		 if (ret != HS_OK)
+			 return ret;
+
+		 return cubic_value(xn[*left], fn[*left], dn[*left], xn[*left + 1],
+			 fn[*left + 1], dn[*left + 1], x, f, d, s);
+	 }
+};
+
+typedef HermiteSplineFixed<HS_FIXED_Q> HermiteSplineQ;
+
+#endif
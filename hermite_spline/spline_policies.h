@@ -0,0 +1,247 @@
+// spline_policies.h
+
+/*
+
+Interpolation policies
+
+Each policy describes how a single segment between two key frames
+(x1, f1, d1) and (x2, f2, d2) is interpolated, with the same static
+interface:
+
+	eval(x1, f1, d1, x2, f2, d2, x, *f, *d, *s)
+		value, first and second derivative at x
+
+	bounds(x1, f1, d1, x2, f2, d2, *vmax, *amax)
+		largest absolute first and second derivatives over the segment
+
+	TANGENTS
+		how the derivatives at the key frames are normally obtained
+		(HS_TAN_*)
+
+SplineInterpolator<P> combines a policy with interval bracketing to
+evaluate a whole curve. As the policy is a template parameter, the
+segment code is resolved at compile time and inlined, with no virtual
+dispatch.
+
+(c) 2015 Dynamic Perception LLC
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+*/
+
+#ifndef _SPLINE_POLICIES_h
+#define _SPLINE_POLICIES_h
+
+#include "hermite_spline.h"
+#include "hermite_spline_fixed.h"
+
+// Tangent sources
+#define HS_TAN_MANUAL		0	// Derivatives are supplied with the key frames
+#define HS_TAN_MONOTONE		1	// Derivatives are generated with Fritsch-Carlson monotone slopes
+#define HS_TAN_CATMULL		2	// Derivatives are generated with Catmull-Rom slopes
+
+// Straight lines between key frames, derivatives are ignored. The velocity changes instantly at each key frame,
+// so the acceleration is unbounded
+class SplineLinear
+{
+ public:
+
+	 static const uint8_t TANGENTS = HS_TAN_MANUAL;
+
+	 static inline void eval(float x1, float f1, float, float x2, float f2,
+		 float, float x, float* f, float* d, float* s){
+		 float del = (f2 - f1) / (x2 - x1);
+		 *f = f1 + (x - x1) * del;
+		 *d = del;
+		 *s = 0;
+	 }
+
+	 static inline void bounds(float x1, float f1, float, float x2, float f2,
+		 float, float* vmax, float* amax){
+		 *vmax = fabs((f2 - f1) / (x2 - x1));
+		 *amax = INFINITY;
+	 }
+};
+
+// Cubic Hermite segments with the supplied derivatives
+class SplineCubicHermite
+{
+ public:
+
+	 static const uint8_t TANGENTS = HS_TAN_MANUAL;
+
+	 static inline void eval(float x1, float f1, float d1, float x2, float f2,
+		 float d2, float x, float* f, float* d, float* s){
+		 HermiteSpline::cubic_value(x1, f1, d1, x2, f2, d2, 1, &x, f, d, s);
+	 }
+
+	 static inline void bounds(float x1, float f1, float d1, float x2, float f2,
+		 float d2, float* vmax, float* amax){
+		 HermiteSpline::cubic_bounds(x1, f1, d1, x2, f2, d2, vmax, amax);
+	 }
+};
+
+// Cubic Hermite segments with Catmull-Rom derivatives
+class SplineCatmullRom : public SplineCubicHermite
+{
+ public:
+
+	 static const uint8_t TANGENTS = HS_TAN_CATMULL;
+};
+
+// Cubic Hermite segments with monotone derivatives, which never overshoot the key frames
+class SplineMonotone : public SplineCubicHermite
+{
+ public:
+
+	 static const uint8_t TANGENTS = HS_TAN_MONOTONE;
+};
+
+// Cubic Hermite segments evaluated with the HermiteSplineQ integer kernel, for checking its precision against
+// SplineCubicHermite on the same key frames. The knots and results are converted from and to float on every call,
+// so it does no less float work than SplineCubicHermite. Positions are rounded to whole microsteps and the
+// segment length to whole ms, while x keeps its fraction through the normalised position. No state is kept
+// between calls, so segments of several axes can be evaluated in any order
+class SplineFixedHermite : public SplineCubicHermite
+{
+ public:
+
+	 static inline void eval(float x1, float f1, float d1, float x2, float f2,
+		 float d2, float x, float* f, float* d, float* s){
+
+		 int32_t h = lround(x2 - x1);
+		 int32_t fi, di, si;
+
+		 if (h <= 0 || HermiteSplineQ::cubic_value_u(lround(f1), lround(d1 * HermiteSplineQ::ONE), lround(f2),
+			 lround(d2 * HermiteSplineQ::ONE), h, HermiteSplineQ::reciprocal(h),
+			 lround((x - x1) / (x2 - x1) * HermiteSplineQ::ONE), &fi, &di, &si) != HS_OK){
+			 SplineCubicHermite::eval(x1, f1, d1, x2, f2, d2, x, f, d, s);
+			 return;
+		 }
+
+		 *f = fi;
+		 *d = (float)di / HermiteSplineQ::ONE;
+		 *s = (float)si / HermiteSplineQ::ONE;
+	 }
+};
+
+// Quintic Hermite segments with zero second derivative at each key frame, so acceleration is continuous
+class SplineQuintic
+{
+ public:
+
+	 static const uint8_t TANGENTS = HS_TAN_MANUAL;
+
+	 static inline void eval(float x1, float f1, float d1, float x2, float f2,
+		 float d2, float x, float* f, float* d, float* s){
+		 float h = x2 - x1;
+		 float a[6];
+		 coefficients(h, f1, d1, f2, d2, a);
+
+		 float u = (x - x1) / h;
+		 *f = a[0] + u * (a[1] + u * u * (a[3] + u * (a[4] + u * a[5])));
+		 *d = (a[1] + u * u * (3 * a[3] + u * (4 * a[4] + u * 5 * a[5]))) / h;
+		 *s = u * (6 * a[3] + u * (12 * a[4] + u * 20 * a[5])) / h / h;
+	 }
+
+	 static inline void bounds(float x1, float f1, float d1, float x2, float f2,
+		 float d2, float* vmax, float* amax){
+		 float h = x2 - x1;
+		 float a[6];
+		 coefficients(h, f1, d1, f2, d2, a);
+
+		 // As a[2] is 0, the acceleration has a root at u = 0 and the velocity's other extremes, like the
+		 // acceleration's, are the roots of a quadratic, so both are found exactly
+		 float u[4] = { 0, 1, 0, 0 };
+		 uint8_t n = 2 + quadratic_roots(20 * a[5], 12 * a[4], 6 * a[3], &u[2]);
+
+		 *vmax = 0;
+		 for (uint8_t i = 0; i < n; i++){
+			 float v = fabs(a[1] + u[i] * u[i] * (3 * a[3] + u[i] * (4 * a[4] + u[i] * 5 * a[5]))) / h;
+			 if (v > *vmax)
+				 *vmax = v;
+		 }
+
+		 n = 2 + quadratic_roots(60 * a[5], 24 * a[4], 6 * a[3], &u[2]);
+
+		 *amax = 0;
+		 for (uint8_t i = 0; i < n; i++){
+			 float s = fabs(u[i] * (6 * a[3] + u[i] * (12 * a[4] + u[i] * 20 * a[5]))) / h / h;
+			 if (s > *amax)
+				 *amax = s;
+		 }
+	 }
+
+ private:
+
+	 // Power coefficients in u = (x - x1) / h of the segment. a[2] is always 0
+	 static inline void coefficients(float h, float f1, float d1, float f2, float d2, float a[6]){
+		 float df = f2 - f1;
+		 float v1 = h * d1;
+		 float v2 = h * d2;
+		 a[0] = f1;
+		 a[1] = v1;
+		 a[2] = 0;
+		 a[3] = 10 * df - 6 * v1 - 4 * v2;
+		 a[4] = -15 * df + 8 * v1 + 7 * v2;
+		 a[5] = 6 * df - 3 * v1 - 3 * v2;
+	 }
+
+	 // Stores the roots of a u^2 + b u + c lying strictly between 0 and 1 in r. Returns how many were found
+	 static inline uint8_t quadratic_roots(float a, float b, float c, float r[2]){
+		 uint8_t n = 0;
+		 float u[2];
+		 uint8_t found = 0;
+
+		 if (a == 0){
+			 if (b != 0)
+				 u[found++] = -c / b;
+		 }
+		 else {
+			 float disc = b * b - 4 * a * c;
+			 if (disc >= 0){
+				 disc = sqrt(disc);
+				 u[found++] = (-b + disc) / (2 * a);
+				 u[found++] = (-b - disc) / (2 * a);
+			 }
+		 }
+
+		 for (uint8_t i = 0; i < found; i++){
+			 if (u[i] > 0 && u[i] < 1)
+				 r[n++] = u[i];
+		 }
+		 return n;
+	 }
+};
+
+// Evaluates a whole curve made of policy P segments
+template <class P>
+class SplineInterpolator
+{
+ public:
+
+	 // Evaluates the curve through nn key frames at x, *left is the interval hint. Returns false if nn is less than 2
+	 static inline bool value(int nn, float xn[], float fn[], float dn[], float x,
+		 float* f, float* d, float* s, int* left){
+
+		 if (!HermiteSpline::r8vec_bracket3(nn, xn, x, left))
+			 return false;
+
+		 P::eval(xn[*left], fn[*left], dn[*left], xn[*left + 1], fn[*left + 1],
+			 dn[*left + 1], x, f, d, s);
+		 return true;
+	 }
+};
+
+#endif
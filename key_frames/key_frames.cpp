@@ -4,6 +4,7 @@
 
 #include "key_frames.h"
 #include "hermite_spline.h"
+#include "../OMAxis/OMAxisCommands.h"
 
 namespace globalKF{
 	int something = 3;
@@ -14,28 +15,53 @@ KeyFrames::KeyFrames(){
 	m_xn = NULL;
 	m_fn = NULL;
 	m_dn = NULL;
+	m_vb = NULL;
+	m_ab = NULL;
 	m_xn_recieved = 0;
 	m_fn_recieved = 0;
 	m_dn_recieved = 0;
 	m_kf_count = 0;
+	m_win_base = 0;
+	m_xn_last = 0;
+	m_underruns = 0;
+	m_bounds_count = 0;
+	m_f[0] = 0;
+	m_d[0] = 0;
+	m_arc_scale = 1;
+	m_s[0] = 0;
+	m_seg = 0;
+	m_x = 0;
 }
 
 // Default destructor
 KeyFrames::~KeyFrames(){
-	freeMemory();
+	// Storage belongs to the arena, nothing to release
 }
 
 // Initialize static class variables
-const int	KeyFrames::G_VALIDATION_PNT_COUNT = 1000;
 int			KeyFrames::g_cur_axis = 0;
 bool		KeyFrames::g_receiving = false;
 int			KeyFrames::g_update_rate = 10;
-bool		KeyFrames::g_mem_allocted = false;
+int			KeyFrames::g_update_min = 5;
+int			KeyFrames::g_update_max = 100;
+float		KeyFrames::g_update_tol = 0;
+uint8_t		KeyFrames::g_tangent_mode = SplineCubicHermite::TANGENTS;
+void		(*KeyFrames::g_eval)(float, float, float, float, float, float, float, float*, float*, float*) = &SplineCubicHermite::eval;
+void		(*KeyFrames::g_bounds)(float, float, float, float, float, float, float*, float*) = &SplineCubicHermite::bounds;
 KeyFrames*	KeyFrames::g_axis_array = NULL;
 int			KeyFrames::g_axis_count = 0;
 float		KeyFrames::g_max_accel = 20000;
 float		KeyFrames::g_max_vel = 4000;
 long		KeyFrames::g_cont_vid_time = -1;
+float*		KeyFrames::g_arena = NULL;
+unsigned int KeyFrames::g_arena_size = 0;
+unsigned int KeyFrames::g_arena_used = 0;
+int			KeyFrames::g_stream_window = 0;
+void		(*KeyFrames::g_f_stream)(int, int, int) = NULL;
+float*		KeyFrames::g_arc_s = NULL;
+float*		KeyFrames::g_arc_dx = NULL;
+float		KeyFrames::g_arc_x0 = 0;
+float		KeyFrames::g_arc_step = 0;
 
 /*** Static Functions ***/
 
@@ -55,6 +81,114 @@ void KeyFrames::setAxisArray(KeyFrames* p_axis_array, int p_axis_count){
 	g_axis_count = p_axis_count;
 }
 
+// Carves all axes' input arrays from an existing block of p_floats floats. Must be called before setKFCount()
+void KeyFrames::setArena(float* p_arena, unsigned int p_floats){
+	g_arena = p_arena;
+	g_arena_size = p_floats;
+	resetArena();
+}
+
+// Releases the storage of every axis in a single step
+void KeyFrames::resetArena(){
+	for (int i = 0; i < g_axis_count; i++){
+		g_axis_array[i].m_kf_count = 0;
+		g_axis_array[i].m_xn = NULL;
+		g_axis_array[i].m_fn = NULL;
+		g_axis_array[i].m_dn = NULL;
+		g_axis_array[i].m_vb = NULL;
+		g_axis_array[i].m_ab = NULL;
+		g_axis_array[i].m_xn_recieved = 0;
+		g_axis_array[i].m_fn_recieved = 0;
+		g_axis_array[i].m_dn_recieved = 0;
+		g_axis_array[i].m_win_base = 0;
+		g_axis_array[i].m_underruns = 0;
+		g_axis_array[i].m_bounds_count = 0;
+	}
+	g_arena_used = 0;
+	g_arc_s = NULL;
+	g_arc_dx = NULL;
+}
+
+// Returns the number of arena floats currently assigned to axes
+unsigned int KeyFrames::arenaUsed(){
+	return g_arena_used;
+}
+
+// Returns the total number of floats in the arena
+unsigned int KeyFrames::arenaSize(){
+	return g_arena_size;
+}
+
+// Assigns each axis a contiguous block of the arena, in axis order. Axes whose block moves lose their received values.
+bool KeyFrames::layoutArena(){
+
+	unsigned int offset = 0;
+
+	// Make sure everything fits before touching any axis
+	for (int i = 0; i < g_axis_count; i++){
+		if (g_axis_array[i].m_kf_count >= 2)
+			offset += g_axis_array[i].capacity() * KF_FLOATS_PER_FRAME;
+	}
+	if (offset > g_arena_size)
+		return false;
+
+	// The arc table follows the axes, so it can't survive a new layout
+	g_arc_s = NULL;
+	g_arc_dx = NULL;
+
+	offset = 0;
+	for (int i = 0; i < g_axis_count; i++){
+		KeyFrames* axis = &g_axis_array[i];
+		int count = axis->capacity();
+
+		// Frame counts of 0 or 1 are just used as indicators and get no storage
+		if (axis->m_kf_count < 2){
+			axis->m_xn = NULL;
+			axis->m_fn = NULL;
+			axis->m_dn = NULL;
+			axis->m_vb = NULL;
+			axis->m_ab = NULL;
+			continue;
+		}
+
+		float* block = g_arena + offset;
+		if (axis->m_xn != block || axis->m_fn != block + count){
+			axis->m_xn_recieved = 0;
+			axis->m_fn_recieved = 0;
+			axis->m_dn_recieved = 0;
+			axis->m_win_base = 0;
+			axis->m_bounds_count = 0;
+		}
+		axis->m_xn = block;
+		axis->m_fn = block + count;
+		axis->m_dn = block + 2 * count;
+		axis->m_vb = block + 3 * count;
+		axis->m_ab = block + 4 * count;
+		offset += count * KF_FLOATS_PER_FRAME;
+	}
+
+	g_arena_used = offset;
+	return true;
+}
+
+// Keeps only p_frames key frames per axis resident (0 disables streaming). Set before setKFCount()
+void KeyFrames::streamWindow(int p_frames){
+	// A window needs at least one segment to interpolate across, plus one to receive into
+	if (p_frames != 0 && p_frames < 3)
+		p_frames = 3;
+	g_stream_window = p_frames;
+}
+
+// Returns the streaming window size in key frames, 0 if streaming is disabled
+int KeyFrames::streamWindow(){
+	return g_stream_window;
+}
+
+// Sets the function called when consumed key frames are evicted and room for more is available
+void KeyFrames::setStreamHandler(void(*p_func)(int, int, int)){
+	g_f_stream = p_func;
+}
+
 // Selects the the current axis
 void KeyFrames::setAxis(int p_axis){
 	g_cur_axis = p_axis;
@@ -80,6 +214,69 @@ int KeyFrames::updateRate(){
 	return g_update_rate;
 }
 
+// Sets the shortest and longest update intervals in ms the adaptive rate may choose
+void KeyFrames::updateRateBounds(int p_min, int p_max){
+	if (p_min < 1 || p_max < p_min)
+		return;
+	g_update_min = p_min;
+	g_update_max = p_max;
+}
+
+// Sets the velocity change allowed between updates in steps/ms, enabling the adaptive rate (0 uses updateRate())
+void KeyFrames::updateTolerance(float p_tolerance){
+	g_update_tol = p_tolerance > 0 ? p_tolerance : 0;
+}
+
+// Returns the velocity change allowed between updates, 0 if the rate is fixed
+float KeyFrames::updateTolerance(){
+	return g_update_tol;
+}
+
+// Returns the ms until the next update, from the accelerations at and ahead of the last evaluation of each axis
+int KeyFrames::nextUpdate(){
+
+	if (g_update_tol <= 0)
+		return g_update_rate;
+
+	// The velocity changes by roughly accel * dt, so the most sharply accelerating axis sets the interval
+	int interval = g_update_max;
+	for (int i = 0; i < g_axis_count; i++){
+		KeyFrames* axis = &g_axis_array[i];
+		int count = g_stream_window > 0 ? axis->getResidentCount() : axis->m_kf_count;
+
+		if (axis->m_kf_count < 2 || count < 2)
+			continue;
+
+		float accel = abs(axis->m_s[0]);
+		int axis_interval = updateInterval(accel);
+
+		// Segments the interval would cross may accelerate harder than the current point. Their bounds are
+		// computed as playback first reaches them, so no tick works out the whole curve at once
+		for (int j = axis->m_seg + 1; j < count - 1 && axis->m_xn[j] < axis->m_x + axis_interval; j++){
+			axis->updateBounds(j);
+			if (axis->m_ab[j] > accel){
+				accel = axis->m_ab[j];
+				axis_interval = updateInterval(accel);
+			}
+		}
+
+		if (axis_interval < interval)
+			interval = axis_interval;
+	}
+
+	return interval;
+}
+
+// Returns the adaptive update interval for the given acceleration
+int KeyFrames::updateInterval(float p_accel){
+
+	if (p_accel * g_update_max <= g_update_tol)
+		return g_update_max;
+
+	int interval = g_update_tol / p_accel;
+	return interval < g_update_min ? g_update_min : interval;
+}
+
 // Set whether the NMX is currently receiving key frame input data
 void KeyFrames::receiveState(bool p_state){
 	g_receiving = p_state;
@@ -90,51 +287,222 @@ bool KeyFrames::receiveState(){
 	return g_receiving;
 }
 
-// Sets the key frame count and allocates memory for input vars
-void KeyFrames::setKFCount(int p_kf_count){
+// Sets whether derivatives are received or generated from the positions (KF_TAN_*)
+void KeyFrames::tangentMode(uint8_t p_mode){
+	g_tangent_mode = p_mode;
+}
+
+// Returns the tangent mode
+uint8_t KeyFrames::tangentMode(){
+	return g_tangent_mode;
+}
+
+// Generates all derivatives from existing xn/fn arrays according to the tangent mode
+void KeyFrames::generateDN(){
+
+	int count = g_stream_window > 0 ? getResidentCount() : m_kf_count;
 
-	// Don't allow negative counts or a single frame
-	if (p_kf_count < 0)
+	if (g_tangent_mode == KF_TAN_CATMULL)
+		HermiteSpline::catmull_rom_slopes(count, m_xn, m_fn, m_dn);
+	else
+		HermiteSpline::monotone_slopes(count, m_xn, m_fn, m_dn);
+
+	m_bounds_count = 0;
+}
+
+// Generates derivatives for every received frame whose neighbours are known
+void KeyFrames::updateDN(){
+
+	if (g_tangent_mode == KF_TAN_MANUAL)
 		return;
 
-	m_kf_count = p_kf_count;
+	int received = m_xn_recieved < m_fn_recieved ? m_xn_recieved : m_fn_recieved;
 
-	// Only allocate memory for 2 or more frames. Frame counts of 0 or 1 are just used as indicators
-	if (p_kf_count >= 2){
+	while (m_dn_recieved < received){
+		int which = m_dn_recieved;
+		int i = which - m_win_base;
 
-		// Free any memory that may have been already allocated
-		freeMemory();		
+		// Interior frames need the following frame as well
+		if (which < m_kf_count - 1 && which + 1 >= received)
+			return;
 
-		// Allocate memory for and reset the received values for each		
-		m_xn = (float *)malloc(m_kf_count * sizeof(float));
-		m_fn = (float *)malloc(m_kf_count * sizeof(float));
-		m_dn = (float *)malloc(m_kf_count * sizeof(float));
-		m_xn_recieved = 0;
-		m_fn_recieved = 0;
-		m_dn_recieved = 0;			
-		
-		g_mem_allocted = true;
+		autoDN(i);
+		m_dn_recieved++;
 	}
 }
 
+// Generates the derivative of the frame stored at index p_i from its neighbours
+void KeyFrames::autoDN(int p_i){
+
+	int which = p_i + m_win_base;
+
+	if (which == 0)
+		m_dn[p_i] = (m_fn[p_i + 1] - m_fn[p_i]) / (m_xn[p_i + 1] - m_xn[p_i]);
+	else if (which == m_kf_count - 1)
+		m_dn[p_i] = (m_fn[p_i] - m_fn[p_i - 1]) / (m_xn[p_i] - m_xn[p_i - 1]);
+	else {
+		float h0 = m_xn[p_i] - m_xn[p_i - 1];
+		float h1 = m_xn[p_i + 1] - m_xn[p_i];
+		float del0 = (m_fn[p_i] - m_fn[p_i - 1]) / h0;
+		float del1 = (m_fn[p_i + 1] - m_fn[p_i]) / h1;
+
+		if (g_tangent_mode == KF_TAN_CATMULL)
+			m_dn[p_i] = HermiteSpline::catmull_rom_slope(h0, del0, h1, del1);
+		else
+			m_dn[p_i] = HermiteSpline::monotone_slope(h0, del0, h1, del1);
+	}
+}
+
+// Sets the key frame count and assigns arena storage for input vars. Returns false if the arena is too small
+bool KeyFrames::setKFCount(int p_kf_count){
+
+	// Don't allow negative counts, or axes that aren't part of the axis array
+	if (p_kf_count < 0 || this < g_axis_array || this >= g_axis_array + g_axis_count)
+		return false;
+
+	int last_count = m_kf_count;
+	m_kf_count = p_kf_count;
+
+	if (!layoutArena()){
+		m_kf_count = last_count;
+		return false;
+	}
+
+	m_xn_recieved = 0;
+	m_fn_recieved = 0;
+	m_dn_recieved = 0;
+	m_win_base = 0;
+	m_underruns = 0;
+	m_bounds_count = 0;
+
+	return true;
+}
+
 // Returns the key frame count
 int KeyFrames::getKFCount(){
 	return m_kf_count;
 }
 
+// Returns the number of complete key frames currently held in memory
+int KeyFrames::getResidentCount(){
+	int received = m_xn_recieved;
+	if (m_fn_recieved < received)
+		received = m_fn_recieved;
+	if (m_dn_recieved < received)
+		received = m_dn_recieved;
+	return received - m_win_base;
+}
+
+// Returns the index of the next key frame the axis expects to receive
+int KeyFrames::streamNext(){
+
+	// Generated derivatives trail the positions, which are what is sent
+	int received = m_xn_recieved < m_fn_recieved ? m_xn_recieved : m_fn_recieved;
+	if (g_tangent_mode == KF_TAN_MANUAL && m_dn_recieved < received)
+		received = m_dn_recieved;
+	return received;
+}
+
+// Returns the number of key frames the axis has room to receive
+int KeyFrames::streamRoom(){
+	int room = m_win_base + capacity() - streamNext();
+	if (streamNext() + room > m_kf_count)
+		room = m_kf_count - streamNext();
+	return room;
+}
+
+// Returns the number of evaluations that needed key frames not yet received
+unsigned int KeyFrames::underruns(){
+	return m_underruns;
+}
+
+// Packs the key frames wanted by every streaming axis into a CMD_PC_KF_NEED response. Returns its length
+uint8_t KeyFrames::streamRequest(uint8_t* p_buf, uint8_t p_len){
+
+	uint8_t len = 0;
+
+	if (g_stream_window == 0)
+		return 0;
+
+	for (int i = 0; i < g_axis_count && len + OM_KFN_ENTRY <= p_len; i++){
+		KeyFrames* axis = &g_axis_array[i];
+
+		if (axis->m_kf_count < 2 || axis->m_xn == NULL)
+			continue;
+
+		int room = axis->streamRoom();
+		int next = axis->streamNext();
+
+		if (room <= 0 && axis->m_underruns == 0)
+			continue;
+
+		p_buf[len++] = i;
+		p_buf[len++] = next >> 8;
+		p_buf[len++] = next & 0xFF;
+		p_buf[len++] = room > 255 ? 255 : (room < 0 ? 0 : room);
+		p_buf[len++] = axis->m_underruns > 255 ? 255 : axis->m_underruns;
+	}
+
+	return len;
+}
+
+// Number of key frames the input arrays can hold
+int KeyFrames::capacity(){
+	if (g_stream_window > 0 && g_stream_window < m_kf_count)
+		return g_stream_window;
+	return m_kf_count;
+}
+
+// Evicts key frames that lie entirely before the given x when streaming
+void KeyFrames::advance(float p_x){
+
+	if (g_stream_window == 0)
+		return;
+
+	// Keep the frame starting the segment that contains x
+	int resident = getResidentCount();
+	int evict = 0;
+	while (evict + 2 < resident && m_xn[evict + 1] <= p_x)
+		evict++;
+
+	if (evict == 0)
+		return;
+
+	// Only frames that were fully received are dropped, so all arrays move together
+	int keep = capacity() - evict;
+	memmove(m_xn, m_xn + evict, keep * sizeof(float));
+	memmove(m_fn, m_fn + evict, keep * sizeof(float));
+	memmove(m_dn, m_dn + evict, keep * sizeof(float));
+	memmove(m_vb, m_vb + evict, keep * sizeof(float));
+	memmove(m_ab, m_ab + evict, keep * sizeof(float));
+	m_win_base += evict;
+	m_seg = m_seg > evict ? m_seg - evict : 0;
+	m_bounds_count = m_bounds_count > evict ? m_bounds_count - evict : 0;
+
+	if (g_f_stream != NULL)
+		g_f_stream(this - g_axis_array, streamNext(), streamRoom());
+}
+
 // Points xn to an existing array of values
 void KeyFrames::setXN(float* p_xn){
 
-	if (!g_mem_allocted)
+	if (m_xn == NULL)
 		return;
 
 	m_xn = p_xn;
+	m_bounds_count = 0;
 }
 
 // Assigns xn values one at a time	
 void KeyFrames::setXN(float p_input){
-	m_xn[m_xn_recieved] = p_input;
+	// Values before the window, e.g. after a reset of only some of the arrays, have nowhere to go
+	if (m_xn_recieved >= m_kf_count || m_xn_recieved < m_win_base || m_xn_recieved - m_win_base >= capacity() || m_xn == NULL)
+		return;
+	if (m_xn_recieved == m_kf_count - 1)
+		m_xn_last = p_input;
+	m_xn[m_xn_recieved - m_win_base] = p_input;
 	m_xn_recieved++;
+	updateDN();
 }
 
 // Returns the number of xn values that have been assigned. Accurate only when assigning values one at a time.
@@ -145,11 +513,13 @@ int KeyFrames::countXN(){
 // Resets the xn received count
 void KeyFrames::resetXN(){
 	m_xn_recieved = 0;
+	m_win_base = 0;
+	m_bounds_count = 0;
 }
 
 // Returns the abscissa of the requested key frame
 float KeyFrames::getXN(int p_which){
-	return m_xn[p_which];
+	return m_xn[p_which - m_win_base];
 }
 
 // Returns the largest of the final xn values for all axes. This is useful for determining the length of a program.
@@ -159,7 +529,9 @@ float KeyFrames::getMaxLastXN(){
 
 	for (byte i = 0; i < KeyFrames::g_axis_count; i++){		
 		int max_frame_num = KeyFrames::g_axis_array[i].m_kf_count;		
-		float this_xn = KeyFrames::g_axis_array[i].m_xn[max_frame_num-1];		
+		if (max_frame_num < 2)
+			continue;
+		float this_xn = KeyFrames::g_stream_window > 0 ? KeyFrames::g_axis_array[i].m_xn_last : KeyFrames::g_axis_array[i].m_xn[max_frame_num-1];		
 		if (this_xn > max_xn)
 			max_xn = this_xn;
 	}
@@ -167,29 +539,19 @@ float KeyFrames::getMaxLastXN(){
 	return max_xn;
 }
 
-// Deallocates any memory assigned to input arrays
-void KeyFrames::freeMemory(){
-	// If the count has been previously set, deallocate the memory from last time
-	if (g_mem_allocted){
-		free(m_xn);		
-		free(m_fn);
-		free(m_dn);
-		
-		g_mem_allocted = false;
-	}
-}
-
 void KeyFrames::setFN(float* p_fn){
-	if (!g_mem_allocted)
+	if (m_fn == NULL)
 		return;
 	m_fn = p_fn;
+	m_bounds_count = 0;
 }
 
 void KeyFrames::setFN(float p_input){
-	if (!g_mem_allocted)
+	if (m_fn_recieved >= m_kf_count || m_fn_recieved < m_win_base || m_fn_recieved - m_win_base >= capacity() || m_fn == NULL)
 		return;
-	m_fn[m_fn_recieved] = p_input;	
+	m_fn[m_fn_recieved - m_win_base] = p_input;	
 	m_fn_recieved++;
+	updateDN();
 }
 
 int KeyFrames::countFN(){
@@ -199,22 +561,27 @@ int KeyFrames::countFN(){
 // Resets the fn received count
 void KeyFrames::resetFN(){
 	m_fn_recieved= 0;
+	m_win_base = 0;
+	m_bounds_count = 0;
 }
 
 float KeyFrames::getFN(int p_which){
-	return m_fn[p_which];
+	return m_fn[p_which - m_win_base];
 }
 
 void KeyFrames::setDN(float* p_dn){
-	if (!g_mem_allocted)
+	if (m_dn == NULL)
 		return;
 	m_dn = p_dn;
+	m_bounds_count = 0;
 }
 
 void KeyFrames::setDN(float p_input){
-	if (!g_mem_allocted)
+	if (g_tangent_mode != KF_TAN_MANUAL)
+		return;
+	if (m_dn_recieved >= m_kf_count || m_dn_recieved < m_win_base || m_dn_recieved - m_win_base >= capacity() || m_dn == NULL)
 		return; 
-	m_dn[m_dn_recieved] = p_input;
+	m_dn[m_dn_recieved - m_win_base] = p_input;
 	m_dn_recieved++;
 }
 
@@ -225,51 +592,447 @@ int KeyFrames::countDN(){
 // Resets the fn received count
 void KeyFrames::resetDN(){
 	m_dn_recieved = 0;
+	m_win_base = 0;
+	m_bounds_count = 0;
 }
 
 float KeyFrames::getDN(int p_which){
-	return m_dn[p_which];
+	return m_dn[p_which - m_win_base];
+}
+
+// Stores the frames of a CMD_PC_KF_BULK packet (without the command code). Returns false if the packet is malformed or out of sequence
+bool KeyFrames::bulkLoad(const uint8_t* p_data, uint8_t p_len){
+
+	if (p_len < OM_KFB_HEADER || p_data[0] >= g_axis_count)
+		return false;
+
+	KeyFrames* axis = &g_axis_array[p_data[0]];
+	int first = ((int)p_data[1] << 8) | p_data[2];
+	uint8_t count = p_data[3];
+	bool with_dn = p_data[4] & OM_KFB_DN;
+	uint8_t frame_len = with_dn ? OM_KFB_FRAME_DN : OM_KFB_FRAME;
+	float d_scale = 1.0 / ((unsigned long)1 << (p_data[4] & OM_KFB_QMASK));
+
+	if (p_len < OM_KFB_HEADER + count * frame_len || axis->m_xn == NULL)
+		return false;
+
+	// Frames must follow on from those already received, and fit the room left
+	if (first != axis->m_xn_recieved || first != axis->m_fn_recieved || first + count > axis->m_kf_count)
+		return false;
+	if (first + count - axis->m_win_base > axis->capacity())
+		return false;
+	if (g_tangent_mode == KF_TAN_MANUAL && (!with_dn || first != axis->m_dn_recieved))
+		return false;
+
+	// Abscissas are deltas from the previous frame
+	float x = 0;
+	if (first > 0){
+		if (first - 1 < axis->m_win_base)
+			return false;
+		x = axis->m_xn[first - 1 - axis->m_win_base];
+	}
+
+	const uint8_t* frame = p_data + OM_KFB_HEADER;
+
+	for (uint8_t i = 0; i < count; i++){
+		x += ((unsigned int)frame[0] << 8) | frame[1];
+
+		// Sign extend the 24 bit position
+		long f = ((long)frame[2] << 16) | ((long)frame[3] << 8) | frame[4];
+		if (f & 0x800000L)
+			f -= 0x1000000L;
+
+		axis->setXN(x);
+		axis->setFN((float)f);
+
+		if (with_dn)
+			axis->setDN((int16_t)(((unsigned int)frame[5] << 8) | frame[6]) * d_scale);
+
+		frame += frame_len;
+	}
+
+	return true;
+}
+
+// Reduces a dense xn/fn set in place to the key frames needed to stay within p_tolerance of it, filling p_dn. Returns the new count
+int KeyFrames::simplify(float* p_xn, float* p_fn, float* p_dn, int p_count, float p_tolerance, uint8_t* p_keep){
+
+	if (p_count < 3)
+		return p_count;
+
+	// Each kept sample keeps the derivative of the dense curve
+	HermiteSpline::catmull_rom_slopes(p_count, p_xn, p_fn, p_dn);
+
+	memset(p_keep, 0, (p_count + 7) / 8);
+	p_keep[0] |= 1;
+	p_keep[(p_count - 1) / 8] |= 1 << ((p_count - 1) % 8);
+
+	// Split each span between kept samples at its worst sample until none strays too far, without recursion
+	int a = 0;
+	while (a < p_count - 1){
+
+		int b = a + 1;
+		while (!(p_keep[b / 8] & (1 << (b % 8))))
+			b++;
+
+		int worst = -1;
+		float worst_err = p_tolerance;
+
+		for (int i = a + 1; i < b; i++){
+			float f[1];
+			float d[1];
+			float s[1];
+			g_eval(p_xn[a], p_fn[a], p_dn[a], p_xn[b], p_fn[b], p_dn[b], p_xn[i], f, d, s);
+			float err = abs(f[0] - p_fn[i]);
+			if (err > worst_err){
+				worst_err = err;
+				worst = i;
+			}
+		}
+
+		if (worst < 0)
+			a = b;
+		else
+			p_keep[worst / 8] |= 1 << (worst % 8);
+	}
+
+	// Compact the kept samples to the front of the arrays
+	int count = 0;
+	for (int i = 0; i < p_count; i++){
+		if (!(p_keep[i / 8] & (1 << (i % 8))))
+			continue;
+		p_xn[count] = p_xn[i];
+		p_fn[count] = p_fn[i];
+		p_dn[count] = p_dn[i];
+		count++;
+	}
+
+	return count;
+}
+
+// Replaces one received key frame and updates only the segments it affects. Returns false if the frame isn't resident or x breaks the ordering
+bool KeyFrames::editFrame(int p_which, float p_x, float p_f, float p_d){
+
+	int i = p_which - m_win_base;
+	int count = g_stream_window > 0 ? getResidentCount() : m_kf_count;
+	int xn_end = g_stream_window > 0 ? m_xn_recieved - m_win_base : m_kf_count;
+	int dn_end = g_stream_window > 0 ? m_dn_recieved - m_win_base : m_kf_count;
+
+	if (i < 0 || i >= count || m_xn == NULL)
+		return false;
+
+	// The abscissas must stay strictly ascending
+	if ((i > 0 && p_x <= m_xn[i - 1]) || (i + 1 < xn_end && p_x >= m_xn[i + 1]))
+		return false;
+
+	m_xn[i] = p_x;
+	m_fn[i] = p_f;
+	if (p_which == m_kf_count - 1)
+		m_xn_last = p_x;
+
+	// The path length table no longer matches the curve
+	g_arc_s = NULL;
+	g_arc_dx = NULL;
+
+	// Generated derivatives depend on the neighbouring frames, so those change too
+	int first = i - 1;
+	int last = i;
+
+	if (g_tangent_mode == KF_TAN_MANUAL)
+		m_dn[i] = p_d;
+	else {
+		for (int j = i - 1; j <= i + 1; j++){
+			// Skip frames whose derivative hasn't been generated yet, or whose preceding frame was evicted
+			if (j < 0 || j >= dn_end || (j == 0 && m_win_base > 0))
+				continue;
+			autoDN(j);
+		}
+		first = i - 2;
+		last = i + 1;
+	}
+
+	// Segments without up to date bounds are computed on the next validation
+	for (int j = first; j <= last; j++){
+		if (j >= 0 && j < m_bounds_count)
+			segmentBounds(j);
+	}
+
+	return true;
+}
+
+// Applies a CMD_PC_KF_EDIT packet (without the command code). Returns false if the packet is malformed or the edit is refused
+bool KeyFrames::editLoad(const uint8_t* p_data, uint8_t p_len){
+
+	if (p_len < OM_KFE_LEN || p_data[0] >= g_axis_count)
+		return false;
+
+	bool with_dn = p_data[3] & OM_KFB_DN;
+
+	if (with_dn && p_len < OM_KFE_LEN_DN)
+		return false;
+
+	int which = ((int)p_data[1] << 8) | p_data[2];
+	unsigned long x = ((unsigned long)p_data[4] << 24) | ((unsigned long)p_data[5] << 16) | ((unsigned long)p_data[6] << 8) | p_data[7];
+
+	// Sign extend the 24 bit position
+	long f = ((long)p_data[8] << 16) | ((long)p_data[9] << 8) | p_data[10];
+	if (f & 0x800000L)
+		f -= 0x1000000L;
+
+	float d = 0;
+	if (with_dn)
+		d = (int16_t)(((unsigned int)p_data[11] << 8) | p_data[12]) / (float)((unsigned long)1 << (p_data[3] & OM_KFB_QMASK));
+
+	return g_axis_array[p_data[0]].editFrame(which, (float)x, (float)f, d);
 }
 
 float KeyFrames::pos(float p_x){
+	advance(p_x);
 	updateVals(p_x);
 	return m_f[0];
 }
 
 float KeyFrames::vel(float p_x){
+	advance(p_x);
 	updateVals(p_x);
 	return m_d[0];
 }
 
 float KeyFrames::accel(float p_x){
+	advance(p_x);
 	updateVals(p_x);
 	return m_s[0];
 }
 
-/*** Validation Functions ***/
+// Fills p_table with the timing of up to p_count splines starting at p_x. Returns the number of entries written
+int KeyFrames::compileTiming(float p_x, unsigned int p_cycles_per_spline, KFTiming* p_table, int p_count){
 
-bool KeyFrames::validateVel(){
+	int count = g_stream_window > 0 ? getResidentCount() : m_kf_count;
 
-	float increment = m_xn[m_kf_count - 1] / G_VALIDATION_PNT_COUNT - 1;	
-	
-	for (int i = 0; i < G_VALIDATION_PNT_COUNT; i++){
-		updateVals(i * increment);
-		if (abs(m_d[0]) > g_max_vel)
-			return false;
+	if (count < 2)
+		return 0;
+
+	float last_x = g_stream_window > 0 ? m_xn[count - 1] : m_xn[m_kf_count - 1];
+	int seg = m_seg;
+	float last_f = posAt(p_x, &seg);
+	uint16_t dir = KF_TIMING_DIR;
+	bool dir_known = false;
+	int n = 0;
+
+	while (n < p_count && p_x + n * MS_PER_SPLINE < last_x){
+
+		// Steps taken over the spline, from the positions at either end
+		float f = posAt(p_x + (n + 1) * MS_PER_SPLINE, &seg);
+		float steps = f - last_f;
+		last_f = f;
+
+		uint16_t keep = KF_TIMING_KEEP;
+		float off_time = 65535.0;
+
+		// Same conversion as the motor engine's continuous moves. A spline without steps keeps the previous direction
+		if (abs(steps) > 0.000001){
+			dir = steps > 0 ? KF_TIMING_DIR : 0;
+			keep = 0;
+			off_time = p_cycles_per_spline / abs(steps);
+
+			// Splines without steps at the start of the table take the direction of the first move
+			if (!dir_known)
+				for (int i = 0; i < n; i++)
+					p_table[i].cycle_err = (p_table[i].cycle_err & ~KF_TIMING_DIR) | dir;
+			dir_known = true;
+		}
+		if (off_time > 65535.0)
+			off_time = 65535.0;
+
+		uint16_t off_cycles = (uint16_t)off_time;
+		if (off_cycles < 1)
+			off_cycles = 1;
+
+		uint16_t cycle_err = (off_time - off_cycles) * FLOAT_TOLERANCE;
+		if (cycle_err >= FLOAT_TOLERANCE)
+			cycle_err = 0;
+
+		p_table[n].off_cycles = off_cycles;
+		p_table[n].cycle_err = cycle_err | dir | keep;
+		n++;
+	}
+
+	return n;
+}
+
+/*** Arc Length Functions ***/
+
+// Tabulates the path length travelled by all axes together. Returns false if there is no curve, no room in the arena or streaming is enabled
+bool KeyFrames::buildArcTable(){
+
+	g_arc_s = NULL;
+	g_arc_dx = NULL;
+
+	if (g_stream_window > 0 || g_arena_used + 2 * KF_ARC_TABLE_LEN > g_arena_size)
+		return false;
+
+	float first = 0;
+	float last = getMaxLastXN();
+	bool found = false;
+
+	for (int i = 0; i < g_axis_count; i++){
+		KeyFrames* axis = &g_axis_array[i];
+		if (axis->m_kf_count < 2)
+			continue;
+		if (!found || axis->m_xn[0] < first)
+			first = axis->m_xn[0];
+		found = true;
+	}
+
+	if (!found || last <= first)
+		return false;
+
+	g_arc_s = g_arena + g_arena_used;
+	g_arc_dx = g_arc_s + KF_ARC_TABLE_LEN;
+	g_arc_x0 = first;
+	g_arc_step = (last - first) / (KF_ARC_TABLE_LEN - 1);
+	g_arc_s[0] = 0;
+
+	// Simpson's rule over KF_ARC_PANELS panels per table step
+	float h = g_arc_step / KF_ARC_PANELS;
+	float left = arcSpeed(first);
+
+	for (int k = 1; k < KF_ARC_TABLE_LEN; k++){
+		float x = first + (k - 1) * g_arc_step;
+		float sum = 0;
+		for (int p = 0; p < KF_ARC_PANELS; p += 2){
+			float mid = arcSpeed(x + (p + 1) * h);
+			float right = arcSpeed(x + (p + 2) * h);
+			sum += left + 4 * mid + right;
+			left = right;
+		}
+		g_arc_s[k] = g_arc_s[k - 1] + sum * h / 3;
+	}
+
+	// Slopes of x(s) that keep the interpolation monotone. Where the path stands still the slope is left at 0
+	for (int k = 0; k < KF_ARC_TABLE_LEN; k++){
+		float h0 = k > 0 ? g_arc_s[k] - g_arc_s[k - 1] : 0;
+		float h1 = k < KF_ARC_TABLE_LEN - 1 ? g_arc_s[k + 1] - g_arc_s[k] : 0;
+
+		if (k == 0)
+			g_arc_dx[k] = h1 > 0 ? g_arc_step / h1 : 0;
+		else if (k == KF_ARC_TABLE_LEN - 1)
+			g_arc_dx[k] = h0 > 0 ? g_arc_step / h0 : 0;
+		else if (h0 > 0 && h1 > 0)
+			g_arc_dx[k] = HermiteSpline::monotone_slope(h0, g_arc_step / h0, h1, g_arc_step / h1);
+		else
+			g_arc_dx[k] = 0;
 	}
+
 	return true;
 }
 
+// Returns the total path length from the last buildArcTable() call, or 0 without a table
+float KeyFrames::arcLength(){
+	if (g_arc_s == NULL)
+		return 0;
+	return g_arc_s[KF_ARC_TABLE_LEN - 1];
+}
+
+// Returns the x at which the given path length has been travelled
+float KeyFrames::arcTime(float p_s){
+
+	if (g_arc_s == NULL || p_s <= 0)
+		return g_arc_x0;
+	if (p_s >= arcLength())
+		return g_arc_x0 + (KF_ARC_TABLE_LEN - 1) * g_arc_step;
+
+	// Find the last entry at or before p_s
+	int low = 0;
+	int high = KF_ARC_TABLE_LEN - 2;
+	while (low < high){
+		int mid = (low + high + 1) / 2;
+		if (g_arc_s[mid] <= p_s)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+
+	float x1 = g_arc_x0 + low * g_arc_step;
+	float x[1] = { p_s };
+	float f[1];
+	float d[1];
+	float s[1];
+
+	if (g_arc_s[low + 1] <= g_arc_s[low])
+		return x1;
+
+	HermiteSpline::cubic_value(g_arc_s[low], x1, g_arc_dx[low], g_arc_s[low + 1], x1 + g_arc_step, g_arc_dx[low + 1], 1, x, f, d, s);
+	return f[0];
+}
+
+// Sets the path units per motor step of this axis when measuring arc length
+void KeyFrames::arcScale(float p_scale){
+	m_arc_scale = p_scale;
+}
+
+// Returns the path units per motor step of this axis
+float KeyFrames::arcScale(){
+	return m_arc_scale;
+}
+
+// Returns the combined speed of all axes at the given x, in path units per ms
+float KeyFrames::arcSpeed(float p_x){
+
+	float sum = 0;
+
+	for (int i = 0; i < g_axis_count; i++){
+		KeyFrames* axis = &g_axis_array[i];
+
+		// Axes are still outside their own key frames
+		if (axis->m_kf_count < 2 || p_x < axis->m_xn[0] || p_x > axis->m_xn[axis->m_kf_count - 1])
+			continue;
+
+		// Evaluated aside, so that the playback state of the axis is left alone
+		int seg = 0;
+		float d;
+		axis->posAt(p_x, &seg, &d);
+		float v = d * axis->m_arc_scale;
+		sum += v * v;
+	}
+
+	return sqrt(sum);
+}
+
+/*** Validation Functions ***/
+
+bool KeyFrames::validateVel(){
+	return maxVel() <= g_max_vel;
+}
+
 bool KeyFrames::validateAccel(){
+	return maxAccel() <= g_max_accel;
+}
 
-	float increment = m_xn[m_kf_count - 1] / G_VALIDATION_PNT_COUNT - 1;
-	
-	for (int i = 0; i < G_VALIDATION_PNT_COUNT; i++){
-		updateVals(i * increment);
-		if (abs(m_s[0]) > g_max_accel)
-			return false;
+// Returns the largest absolute velocity anywhere on the resident curve
+float KeyFrames::maxVel(){
+
+	float max_vel = 0;
+
+	updateBounds();
+	for (int i = 0; i < m_bounds_count; i++){
+		if (m_vb[i] > max_vel)
+			max_vel = m_vb[i];
 	}
-	return true;
+	return max_vel;
+}
+
+// Returns the largest absolute acceleration anywhere on the resident curve
+float KeyFrames::maxAccel(){
+
+	float max_accel = 0;
+
+	updateBounds();
+	for (int i = 0; i < m_bounds_count; i++){
+		if (m_ab[i] > max_accel)
+			max_accel = m_ab[i];
+	}
+	return max_accel;
 }
 
 void KeyFrames::setMaxVel(float p_max_vel){
@@ -284,14 +1047,88 @@ void KeyFrames::setMaxAccel(float p_max_accel){
 
 void KeyFrames::updateVals(float p_x){
 	float x_point[1];
+
+	// When streaming, only the resident frames can be interpolated
+	int count = g_stream_window > 0 ? getResidentCount() : m_kf_count;
+	int last = g_stream_window > 0 ? count - 1 : m_xn_recieved - 1;
+
+	// Without a segment to interpolate, hold the last position
+	if (count < 2){
+		if (count == 1 && g_stream_window > 0)
+			m_f[0] = m_fn[0];
+		m_d[0] = 0;
+		m_s[0] = 0;
+		if (g_stream_window > 0 && m_kf_count >= 2)
+			m_underruns++;
+		return;
+	}
 	
 	// Don't allow requests for x values less than the first point and greater than the last point
 	if (p_x < m_xn[0])
 		x_point[0] = m_xn[0];
-	else if (p_x > m_xn[m_xn_recieved - 1])
-		x_point[0] = m_xn[m_xn_recieved - 1];
+	else if (p_x > m_xn[last])
+		x_point[0] = m_xn[last];
 	else
 		x_point[0] = p_x;
 
-	HermiteSpline::cubic_spline_value(m_kf_count, m_xn, m_fn, m_dn, 1, x_point, m_f, m_d, m_s);
-}
\ No newline at end of file
+	if (!HermiteSpline::r8vec_bracket3(count, m_xn, x_point[0], &m_seg))
+		return;
+
+	m_x = x_point[0];
+
+	g_eval(m_xn[m_seg], m_fn[m_seg], m_dn[m_seg], m_xn[m_seg + 1], m_fn[m_seg + 1], m_dn[m_seg + 1], x_point[0], m_f, m_d, m_s);
+
+	// Frames that should follow haven't arrived in time, so stand still at the last one
+	if (p_x > m_xn[last] && m_win_base + count < m_kf_count){
+		m_d[0] = 0;
+		m_s[0] = 0;
+		m_underruns++;
+	}
+}
+
+// Returns the position at x using the given segment hint, and the velocity in p_d if given, without evicting frames or updating the output vars
+float KeyFrames::posAt(float p_x, int* p_seg, float* p_d){
+
+	int count = g_stream_window > 0 ? getResidentCount() : m_kf_count;
+	int last = g_stream_window > 0 ? count - 1 : m_xn_recieved - 1;
+	float f, d, s;
+
+	if (p_x < m_xn[0])
+		p_x = m_xn[0];
+	else if (p_x > m_xn[last])
+		p_x = m_xn[last];
+
+	if (!HermiteSpline::r8vec_bracket3(count, m_xn, p_x, p_seg)){
+		if (p_d != NULL)
+			*p_d = 0;
+		return m_fn[0];
+	}
+
+	g_eval(m_xn[*p_seg], m_fn[*p_seg], m_dn[*p_seg], m_xn[*p_seg + 1], m_fn[*p_seg + 1], m_dn[*p_seg + 1], p_x, &f, &d, &s);
+	if (p_d != NULL)
+		*p_d = d;
+	return f;
+}
+
+// Computes the bounds of each resident segment up to index p_last (every one if -1) that lacks them
+void KeyFrames::updateBounds(int p_last){
+
+	int count = g_stream_window > 0 ? getResidentCount() : m_kf_count;
+
+	if (m_vb == NULL)
+		return;
+
+	if (p_last < 0 || p_last > count - 2)
+		p_last = count - 2;
+
+	while (m_bounds_count <= p_last){
+		segmentBounds(m_bounds_count);
+		m_bounds_count++;
+	}
+}
+
+// Computes the bounds of the segment starting at index p_i
+void KeyFrames::segmentBounds(int p_i){
+	g_bounds(m_xn[p_i], m_fn[p_i], m_dn[p_i], m_xn[p_i + 1],
+		m_fn[p_i + 1], m_dn[p_i + 1], &m_vb[p_i], &m_ab[p_i]);
+}
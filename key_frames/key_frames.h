@@ -41,6 +41,32 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 	#include "WProgram.h"
 #endif
 
+#include "spline_policies.h"
+#include "../OMMotorFunctions/OMMotorFunctions.h"
+
+// Number of floats each key frame occupies in the arena (xn, fn, dn, and the velocity and acceleration bounds of the segment it starts)
+#define KF_FLOATS_PER_FRAME	5
+
+// Tangent modes
+#define KF_TAN_MANUAL		HS_TAN_MANUAL	// Derivatives are sent with setDN()
+#define KF_TAN_MONOTONE		HS_TAN_MONOTONE	// Derivatives are generated with Fritsch-Carlson monotone slopes
+#define KF_TAN_CATMULL		HS_TAN_CATMULL	// Derivatives are generated with Catmull-Rom slopes
+
+// Step timing compiler. Splines are MS_PER_SPLINE long and cycle errors are scaled by FLOAT_TOLERANCE, as in the motor engine
+#define KF_TIMING_DIR		0x8000	// Set in KFTiming::cycle_err when the spline moves towards increasing positions
+#define KF_TIMING_KEEP		0x4000	// Set in KFTiming::cycle_err when the spline takes no steps, so the motor keeps its direction
+#define KF_TIMING_ERR		0x3FFF	// Mask of the fractional off cycles in KFTiming::cycle_err
+
+// Compiled step timing of one motor engine spline
+struct KFTiming{
+	uint16_t off_cycles;								// Whole ISR cycles between steps
+	uint16_t cycle_err;									// Fractional ISR cycles between steps times FLOAT_TOLERANCE, plus KF_TIMING_DIR and KF_TIMING_KEEP
+};
+
+// Number of entries in the arc length table, and Simpson's rule panels used per entry
+#define KF_ARC_TABLE_LEN	16
+#define KF_ARC_PANELS		4
+
 class KeyFrames{
 
 public:
@@ -52,6 +78,24 @@ public:
 	static void setAxisArray(KeyFrames* p_axis_array,	// Points the axis_array var to an existing array of key frames objects that represent the axes to be managed
 		int p_axis_count);
 
+	// Key frame storage
+	static void setArena(float* p_arena,				// Carves all axes' input arrays from an existing block of p_floats floats. Must be called before setKFCount()
+		unsigned int p_floats);
+	static void resetArena();							// Releases the storage of every axis in a single step
+	static unsigned int arenaUsed();					// Returns the number of arena floats currently assigned to axes
+	static unsigned int arenaSize();					// Returns the total number of floats in the arena
+
+	// Streaming functions
+	static void streamWindow(int p_frames);				// Keeps only p_frames key frames per axis resident (0 disables streaming). Set before setKFCount()
+	static int streamWindow();							// Returns the streaming window size in key frames, 0 if streaming is disabled
+	static void setStreamHandler(void(*p_func)			// Sets the function called when consumed key frames are evicted and room for more is available
+		(int p_axis, int p_next, int p_room));
+	int streamNext();									// Returns the index of the next key frame the axis expects to receive
+	int streamRoom();									// Returns the number of key frames the axis has room to receive
+	unsigned int underruns();							// Returns the number of evaluations that needed key frames not yet received
+	static uint8_t streamRequest(uint8_t* p_buf,		// Packs the key frames wanted by every streaming axis into a CMD_PC_KF_NEED response. Returns its length
+		uint8_t p_len);
+
 	// Timing getters and setters
 	static void setContVidTime(long p_time);			// Sets the current continuous video length in milliseconds
 	static long getContVidTime();						// Gets the current continuous video length in milliseconds
@@ -64,14 +108,31 @@ public:
 	// Run-time update functions
 	static void updateRate(int p_update_rate);			// Sets the velocity update rate in ms used at run-time
 	static int updateRate();							// Returns the velocity update rate in ms
+	static void updateRateBounds(int p_min, int p_max);	// Sets the shortest and longest update intervals in ms the adaptive rate may choose
+	static void updateTolerance(float p_tolerance);		// Sets the velocity change allowed between updates in steps/ms, enabling the adaptive rate (0 uses updateRate())
+	static float updateTolerance();						// Returns the velocity change allowed between updates, 0 if the rate is fixed
+	static int nextUpdate();							// Returns the ms until the next update, from the accelerations at and ahead of the last evaluation of each axis
 	
 	// Data transmission functions
 	static void receiveState(bool p_state);				// Set whether the NMX is currently receiving key frame input data
 	static bool receiveState();							// Returns whether the NMX is currently receiving key frame input data
 
+	// Interpolation policy
+	template <class P> static void interpolation(){		// Selects the policy used between key frames (SplineLinear, SplineCubicHermite, SplineCatmullRom, SplineMonotone, SplineFixedHermite or SplineQuintic) and its tangent mode
+		g_eval = &P::eval;
+		g_bounds = &P::bounds;
+		g_tangent_mode = P::TANGENTS;
+	}
+
+	// Tangent functions
+	static void tangentMode(uint8_t p_mode);			// Sets whether derivatives are received or generated from the positions (KF_TAN_*)
+	static uint8_t tangentMode();						// Returns the tangent mode
+	void generateDN();									// Generates all derivatives from existing xn/fn arrays according to the tangent mode
+
 	// Key frame count functions
-	void setKFCount(int p_kf_count);					// Sets the key frame count and allocates memory for input vars
+	bool setKFCount(int p_kf_count);					// Sets the key frame count and assigns arena storage for input vars. Returns false if the arena is too small
 	int getKFCount();									// Returns the key frame count
+	int getResidentCount();								// Returns the number of complete key frames currently held in memory
 	
 	// Key frame x location functions
 	void setXN(float* p_xn);							// Points xn to an existing array of values
@@ -95,14 +156,41 @@ public:
 	void resetDN();										// Resets the dn received count
 	float getDN(int p_which);							// Returns the dn value of the requested key frame
 
+	// Bulk upload
+	static bool bulkLoad(const uint8_t* p_data,			// Stores the frames of a CMD_PC_KF_BULK packet (without the command code). Returns false if the packet is malformed or out of sequence
+		uint8_t p_len);
+
+	// Key frame reduction
+	static int simplify(float* p_xn, float* p_fn,		// Reduces a dense xn/fn set in place to the key frames needed to stay within p_tolerance of it, filling p_dn. Returns the new count
+		float* p_dn, int p_count, float p_tolerance, uint8_t* p_keep);
+
+	// Key frame editing functions
+	bool editFrame(int p_which, float p_x,				// Replaces one received key frame and updates only the segments it affects. Returns false if the frame isn't resident or x breaks the ordering
+		float p_f, float p_d);
+	static bool editLoad(const uint8_t* p_data,			// Applies a CMD_PC_KF_EDIT packet (without the command code). Returns false if the packet is malformed or the edit is refused
+		uint8_t p_len);
+
 	// Interpolation functions
 	float pos(float p_x);								// Returns the position rate at the given x
 	float vel(float p_x);								// Returns the velocity at the given x
 	float accel(float p_x);								// Returns the acceleration at the given x
 
+	// Step timing functions
+	int compileTiming(float p_x,						// Fills p_table with the timing of up to p_count splines starting at p_x. Returns the number of entries written
+		unsigned int p_cycles_per_spline, KFTiming* p_table, int p_count);
+
+	// Arc length functions
+	static bool buildArcTable();						// Tabulates the path length travelled by all axes together. Returns false if there is no curve, no room in the arena or streaming is enabled
+	static float arcLength();							// Returns the total path length from the last buildArcTable() call, or 0 without a table
+	static float arcTime(float p_s);					// Returns the x at which the given path length has been travelled
+	void arcScale(float p_scale);						// Sets the path units per motor step of this axis when measuring arc length
+	float arcScale();									// Returns the path units per motor step of this axis
+
 	// Validation functions
 	bool validateVel();									// Returns true if curve does not exceed max motor speed
 	bool validateAccel();								// Returns true if curve does not exceed max motor accel
+	float maxVel();										// Returns the largest absolute velocity anywhere on the resident curve
+	float maxAccel();									// Returns the largest absolute acceleration anywhere on the resident curve
 	static void setMaxVel(float p_max_vel);				// Sets the maximum velocity for validation checking
 	static void setMaxAccel(float p_max_accel);			// Sets the maximum acceleration for validation checking
 	
@@ -117,11 +205,28 @@ private:
 
 	static long g_cont_vid_time;						// Continuous video move time in ms
 	static int g_update_rate;							// Spline update rate in ms
+	static int g_update_min;							// Shortest adaptive update interval in ms
+	static int g_update_max;							// Longest adaptive update interval in ms
+	static float g_update_tol;							// Velocity change allowed between adaptive updates in steps/ms, 0 if the rate is fixed
+	static int updateInterval(float p_accel);			// Returns the adaptive update interval for the given acceleration
+	static uint8_t g_tangent_mode;						// How key frame derivatives are obtained (KF_TAN_*)
+	static void(*g_eval)(float, float, float, float,	// Segment evaluation of the selected interpolation policy
+		float, float, float, float*, float*, float*);
+	static void(*g_bounds)(float, float, float, float,	// Segment bounds of the selected interpolation policy
+		float, float, float*, float*);
 	int m_kf_count;										// Number of key frames
-	static bool g_mem_allocted;							// Indicates whether memory for the input vars has been set
 	static KeyFrames* g_axis_array;						// The array of key frame objects. Allow cycling through each object when allocating memory
 	static int g_axis_count;							// Number of axes to be managed
 
+	// Streaming vars
+	static int g_stream_window;							// Number of key frames kept resident per axis, 0 when streaming is disabled
+	static void(*g_f_stream)(int, int, int);			// Called with the axis, next expected frame and free room after frames are evicted
+	int m_win_base;										// Index of the key frame stored at the start of the input arrays
+	float m_xn_last;									// Abscissa of the final key frame, once received
+	unsigned int m_underruns;							// Number of evaluations past the last resident frame before the final frame was received
+	int capacity();										// Number of key frames the input arrays can hold
+	void advance(float p_x);							// Evicts key frames that lie entirely before the given x when streaming
+
 	// Input / output vars
 	float* m_xn;										// Abscissas of key frame locations
 	float* m_fn;										// Ordinate of current axis key frame location
@@ -129,16 +234,36 @@ private:
 	float m_f[1];										// Current axis curve's location at calculated point
 	float m_d[1];										// Current axis curve's first derivative at calculated point
 	float m_s[1];										// Current axis curve's second derivative at calculated point
+	int m_seg;											// Index of the segment last interpolated, used as the search hint for the next point
+	float m_x;											// x of the last interpolated point
 	
 	void updateVals(float p_x);							// Updates the output vars for the given locations
+	float posAt(float p_x, int* p_seg, float* p_d = NULL);	// Returns the position at x using the given segment hint, and the velocity in p_d if given, without evicting frames or updating the output vars
+	void updateDN();									// Generates derivatives for every received frame whose neighbours are known
+	void autoDN(int p_i);								// Generates the derivative of the frame stored at index p_i from its neighbours
+
+	// Arc length vars
+	static float* g_arc_s;								// Path length travelled at each evenly spaced x in the table, kept in the arena after the axes. NULL without a table
+	static float* g_arc_dx;								// Derivative of x with respect to path length at each table entry
+	static float g_arc_x0;								// x of the first table entry
+	static float g_arc_step;							// x spacing of the table entries
+	float m_arc_scale;									// Path units per motor step of this axis
+	static float arcSpeed(float p_x);					// Returns the combined speed of all axes at the given x, in path units per ms
 
 	// Validation vars
-	static const int G_VALIDATION_PNT_COUNT;			// Number of points to check on spline for validation purposes
+	float* m_vb;										// Largest absolute velocity on the segment starting at each key frame
+	float* m_ab;										// Largest absolute acceleration on the segment starting at each key frame
+	int m_bounds_count;									// Number of leading resident segments whose bounds are up to date
+	void updateBounds(int p_last = -1);					// Computes the bounds of each resident segment up to index p_last (every one if -1) that lacks them
+	void segmentBounds(int p_i);						// Computes the bounds of the segment starting at index p_i
 	static float g_max_vel;								// Absolute maximum velocity
 	static float g_max_accel;							// Absolute maximum acceleration
 
 	// Memory management
-	void freeMemory();									// Deallocates any memory assigned to input arrays
+	static float* g_arena;								// Arena all axes' input arrays are carved from
+	static unsigned int g_arena_size;					// Number of floats in the arena
+	static unsigned int g_arena_used;					// Number of floats currently assigned to axes
+	static bool layoutArena();							// Assigns each axis a contiguous block of the arena, in axis order
 };
 
 #endif
@@ -156,19 +281,140 @@ private:
 
 	2. Attach the array to class using static function KeyFrames::setAxisArray(KeyFrames* p_axis_array)
 
-	3. Set the key frame count using static function KeyFrames::count(int p_kf_count). This will allocate the necessary
-	   memory to the input variable arrays
+	3. Set the key frame count using KeyFrames::setKFCount(int p_kf_count). This will assign the necessary
+	   storage to the input variable arrays. All axes share one arena, a block of floats of your own passed to
+	   KeyFrames::setArena() beforehand, in which each axis occupies KF_FLOATS_PER_FRAME floats per key frame
+	   directly after the axes before it. A frame takes five floats (20 bytes): the abscissa, position and
+	   derivative, plus the velocity and acceleration bounds cached for the segment it starts, so an arena holds
+	   3/5 as many frames as it would for the three values alone. No memory is reserved for key frames until an arena is supplied, and
+	   setKFCount() fails without one. Changing the count of one axis invalidates any values already received
+	   for the axes that follow it, so counts should be set in axis order before sending values.
+	   KeyFrames::resetArena() releases the storage of every axis at once, e.g. before uploading a new program.
+	   The heap is never used.
+
+	   @code
+	   // room for 19 key frames on one axis, or 9 on each of two
+	   float kf_arena[96];
+	   KeyFrames::setArena(kf_arena, 96);
+	   @endcode
 
 	5. Assign the key frame anscissas, positions, and velocities one at a time or by passing an existing array using functions
 	   setXN(int p_which, float p_input) or setXN(float* p_xn), setFN(int p_which, float p_input) or setFN(float* p_fn), 
 	   and setDN(int p_which, float p_input) or setDN(float* p_dn). This must be done for each object in the KeyFrame array 
 	   you've created, since each motor may have different times, positions and velocities. 
 	   
+	   When KeyFrames::tangentMode() is set to KF_TAN_MONOTONE or KF_TAN_CATMULL, the derivatives are not sent at all.
+	   They are generated on the node as abscissas and positions arrive (or by generateDN() when existing arrays are
+	   used) and setDN() is ignored. Monotone tangents guarantee the curve never overshoots between key frames.
+
 	   *** IMPORTANT ***: You must ensure that the number of assigned values for each matches the key frame count, otherwise 
 	   things may go horribly wrong. Additionally, the abscissa values must be strictly sorted in ascending order for the same reason.
 
+	   A single key frame that has already been received may later be replaced with editFrame(int p_which, float p_x,
+	   float p_f, float p_d), e.g. while the user drags it in the app. Only the segments on either side of it (and, when
+	   derivatives are generated, the segments beside those) are updated, so the rest of the axis does not need to be
+	   sent or checked again. p_d is ignored when derivatives are generated. Over MoCoBus, OMAxis::editKeyFrame() sends the
+	   frame in a CMD_PC_KF_EDIT packet, whose data following the command code the node passes to KeyFrames::editLoad().
+
+	   The curve between key frames is a cubic Hermite spline unless another policy from spline_policies.h is selected
+	   with KeyFrames::interpolation<P>() before the key frames are sent: SplineLinear, SplineCatmullRom and SplineMonotone
+	   (cubic Hermite with the matching tangent mode as the default), SplineFixedHermite, the same curve evaluated by the
+	   integer kernel of hermite_spline_fixed.h to whole microsteps for comparison with the float one, or SplineQuintic, whose acceleration is continuous
+	   across key frames. The policy's segment code is instantiated in the sketch that selects it, so only the policies
+	   used are linked in, and is then reached through a single function pointer with no virtual dispatch. SplineLinear
+	   changes velocity instantly at each key frame, so its acceleration bounds are infinite and validateAccel() fails.
+
+	   @code
+	   KeyFrames::interpolation<SplineQuintic>();
+	   @endcode
+
 	5. Once steps 1-4 have been completed, the position, velocity, or acceleration at any x location between the first and last
 	   key frame abscissa may be retrieved with the pos(float p_x), vel(float p_x), accel(float p_x) functions.
+	   By default, the curve is evaluated every updateRate() ms during playback. Setting KeyFrames::updateTolerance()
+	   instead lets KeyFrames::nextUpdate() choose each interval from the accelerations found by the last evaluation,
+	   so that no axis' velocity changes by more than the tolerance between updates. Where the interval would reach into
+	   following segments, their acceleration bounds shorten it too, so a gentle segment never steps over a sharp one. Gentle stretches of a move are then
+	   evaluated rarely and sharp accelerations often, within the limits set with KeyFrames::updateRateBounds().
+	   validateVel() and validateAccel() use the exact velocity and acceleration bounds of each segment, which are
+	   computed once and kept in the arena alongside the key frames.
+
+	@section kfbulk Bulk Upload
+
+	Sending every value with its own command costs a packet header and a response per float. A master may instead pack
+	many key frames into a single CMD_PC_KF_BULK packet with OMAxis::keyFrames(), with abscissas sent as deltas in ms,
+	positions as whole steps and derivatives in fixed point (or left out when they are generated on the node). On the
+	node, the command handler passes the packet data following the command code to KeyFrames::bulkLoad(), which
+	stores the frames straight into the arena in the order setXN(), setFN() and setDN() would. Frames must follow on
+	from those already received for the axis, and must fit its remaining room when streaming. With the OM_SER_BUFLEN
+	byte command buffer, each packet holds five frames, or three when derivatives are sent.
+
+	@section kfsimplify Reducing Recorded Moves
+
+	Moves recorded by hand produce far more key frames than their shape needs. Before uploading such a move,
+	KeyFrames::simplify(float* p_xn, float* p_fn, float* p_dn, int p_count, float p_tolerance, uint8_t* p_keep) may
+	be run over the dense abscissas and positions. Derivatives for every sample are estimated from the data, then,
+	Douglas-Peucker style, a key frame is only kept where the Hermite curve through the key frames kept so far strays
+	further than p_tolerance steps from the recorded samples. The arrays are compacted in place and the new key frame
+	count is returned, with p_dn holding the matching derivatives. p_keep is scratch space of at least
+	(p_count + 7) / 8 bytes supplied by the caller, so the heap is never used.
+
+	@section kftiming Compiled Step Timing
+
+	Rather than evaluating vel() and converting speeds to step timing while the motors run, each axis may be
+	compiled ahead of time into the per-spline {off cycles, cycle error} values the motor engine consumes.
+	compileTiming(float p_x, unsigned int p_cycles_per_spline, KFTiming* p_table, int p_count) fills a table of
+	your own with the splines starting at p_x, each MS_PER_SPLINE ms long, and may be called repeatedly to
+	compile a long program in chunks. The steps in each spline are taken from the positions at either end of it,
+	so rounding never accumulates into a position error. p_cycles_per_spline must be the value returned by
+	OMMotorFunctions::cyclesPerSpline(). Compiling doesn't evict streamed key frames or change the values last
+	returned by pos(), vel() and accel().
+
+	During playback, whenever the motor's splineReady flag is false, the next entry is handed to the motor with
+	OMMotorFunctions::splineTiming(entry.cycle_err & KF_TIMING_KEEP ? OM_MOT_NO_DIR : (entry.cycle_err & KF_TIMING_DIR ? 1 : 0),
+	entry.off_cycles, entry.cycle_err & KF_TIMING_ERR) instead of calling updateSpline(), so no float arithmetic is
+	needed. Splines that take no steps are marked KF_TIMING_KEEP so that a pause never changes the motor's direction
+	or triggers its backlash compensation; their KF_TIMING_DIR bit repeats the direction of the move before them in
+	the same table, or of the first move after them.
+
+	@section kfarc Constant Speed Moves
+
+	Key frames are timed, so the camera normally slows and speeds up along its path as the axes do. To travel the
+	path at a constant linear speed instead, set each axis' arcScale() to the path units moved per motor step (steps
+	of rotary axes may be left at 1, or scaled to taste), then call KeyFrames::buildArcTable() once all key frames
+	are received. This tabulates the combined path length over KF_ARC_TABLE_LEN evenly spaced points, integrating with
+	Simpson's rule, and stores only the length and its slope at each point. The table is kept in the arena after the
+	key frames and needs 2 * KF_ARC_TABLE_LEN floats of it to be free; it is discarded whenever the arena is laid out
+	again, e.g. by setKFCount(), or a key frame is replaced with editFrame(), and arcLength() returns 0 until it is
+	rebuilt. Building the table doesn't disturb playback, so it may be rebuilt while a program runs.
+
+	KeyFrames::arcTime(float p_s) then returns the x at which a given path length is reached, using a table search and
+	monotone cubic interpolation, so the x to evaluate for a constant speed traversal of duration T at time t is simply
+	arcTime(arcLength() * t / T). The table covers every axis and therefore can't be used while streaming.
+
+	@section kfstream Streaming Key Frames
+
+	Programs with more key frames than fit in memory may be streamed. Calling KeyFrames::streamWindow(int p_frames) before
+	setting the key frame counts limits each axis to p_frames resident key frames, while setKFCount() still receives the
+	full count for the program. Key frames are then sent one at a time with setXN(float), setFN(float) and setDN(float)
+	as room becomes available, and the indices used by getXN(), getFN() and getDN() remain those of the whole program.
+
+	As pos(), vel() and accel() are called with increasing x values, key frames lying entirely before the current segment
+	are evicted, and the handler set with setStreamHandler() is called with the axis, the index of the next key frame
+	that axis expects (streamNext()) and how many frames it now has room for (streamRoom()). Room is made as soon as a
+	frame has been passed, so frames are fetched a whole window ahead of the point where they are needed.
+
+	Over MoCoBus, the master fetches frames by polling: the node answers a CMD_PC_KF_NEED command with the response
+	KeyFrames::streamRequest() packs, listing for each streaming axis the next frame it expects, the room it has and its
+	underrun count, and OMAxis::streamKeyFrames() then sends the frames requested with CMD_PC_KF_BULK packets (see
+	bulkLoad()). The master should poll at least once in the time the shortest window of segments takes to play.
+
+	If an evaluation reaches beyond the last resident frame before the final frame of the program has arrived, the
+	axis holds the position of that frame with zero velocity and acceleration, and the underrun is counted by
+	underruns() and reported to the master. An axis holding fewer than two frames likewise reports zero velocity and
+	acceleration rather than the results of an earlier evaluation.
+
+	While streaming, x values may only increase, validateVel() and validateAccel() only check the resident frames, and
+	getMaxLastXN() requires the final abscissa of each axis to have been received.
 
 */
 